@@ -0,0 +1,214 @@
+/**
+ * AST bank reader
+ *
+ * A bank (.astb) packs many AST files into one so that a stream can be resolved without opening and seeking a file per stream.
+ * Each stream is stored as an unmodified STRM+BLCK image (exactly as it would be written to a standalone AST) starting on a multiple of the bank alignment.
+ * All values are Big Endian, same as AST.
+ *
+ * BANK HEADER
+ *	0x0000  "ASTB"
+ *	0x0004  version (2)
+ *	0x0008  alignment of stream images in bytes (multiple of 32)
+ *	0x000C  number of streams
+ *	0x0010  number of index slots (0 or a power of two)
+ *	0x0014  offset of index
+ *	0x0018  size of name table in bytes
+ *	0x001C  4 bytes of 0s
+ *
+ * INDEX SLOT (16 bytes each)
+ *	0x0000  hash of stream name (see astBankHash)
+ *	0x0004  offset of stream image
+ *	0x0008  size of stream image (0 if slot is empty)
+ *	0x000C  offset of stream name within the name table
+ *
+ * The name table directly follows the slots and holds the name of every stream (filename without directory, null terminated).
+ * Slots are looked up starting at (hash & (slots - 1)) with linear probing, and the table is never more than half full, so a stream resolves in O(1) on a memory mapped bank.
+ * Names are compared on a hash hit, so two names with the same hash never resolve to each other's stream.
+ * Streams and the index are only ever written to unused space, and the header is written last, so an interrupted write leaves the previous contents of the bank readable.
+ *
+ * This header has no dependencies on the rest of the AST creator and may be dropped into other projects.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define AST_BANK_VERSION 2
+#define AST_BANK_HEADER_SIZE 32
+#define AST_BANK_SLOT_SIZE 16
+
+// Reads a Big Endian 32-bit value
+static inline uint32_t astBankRead32(const unsigned char *p) {
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+// Returns the filename without directory
+static inline const char *astBankBaseName(const char *name) {
+	const char *base = name;
+	for (const char *c = name; *c; ++c) {
+		if (*c == '/' || *c == '\\')
+			base = c + 1;
+	}
+	return base;
+}
+
+// Hashes a stream name (32-bit FNV-1a of the filename without directory, case insensitive)
+static inline uint32_t astBankHash(const char *name) {
+	const char *base = astBankBaseName(name);
+
+	uint32_t hash = 2166136261u;
+	for (const char *c = base; *c; ++c) {
+		unsigned char ch = (unsigned char) *c;
+		if (ch >= 'A' && ch <= 'Z')
+			ch += 'a' - 'A';
+		hash ^= ch;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Compares two stream names (case insensitive, directories are ignored)
+static inline int astBankNameEqual(const char *a, const char *b) {
+	a = astBankBaseName(a);
+	b = astBankBaseName(b);
+	for (; *a && *b; ++a, ++b) {
+		unsigned char ca = (unsigned char) *a, cb = (unsigned char) *b;
+		if (ca >= 'A' && ca <= 'Z')
+			ca += 'a' - 'A';
+		if (cb >= 'A' && cb <= 'Z')
+			cb += 'a' - 'A';
+		if (ca != cb)
+			return 0;
+	}
+	return *a == *b;
+}
+
+// Returns nonzero if the buffer holds a valid bank header (only the header needs to be in the buffer, bankSize is that of the whole file)
+static inline int astBankValid(const unsigned char *bank, size_t bankSize) {
+	if (bankSize < AST_BANK_HEADER_SIZE || bank[0] != 'A' || bank[1] != 'S' || bank[2] != 'T' || bank[3] != 'B')
+		return 0;
+	if (astBankRead32(bank + 0x04) != AST_BANK_VERSION)
+		return 0;
+
+	uint32_t alignment = astBankRead32(bank + 0x08);
+	uint32_t slots = astBankRead32(bank + 0x10);
+	uint64_t indexEnd = (uint64_t) astBankRead32(bank + 0x14) + (uint64_t) slots * AST_BANK_SLOT_SIZE + astBankRead32(bank + 0x18);
+	return alignment != 0 && alignment % 32 == 0 && (slots & (slots - 1)) == 0 && indexEnd <= bankSize;
+}
+
+// Finds a stream by name and returns a pointer to its STRM+BLCK image (NULL if the stream is not in the bank)
+static inline const unsigned char *astBankFind(const unsigned char *bank, size_t bankSize, const char *name, uint32_t *size) {
+	if (!astBankValid(bank, bankSize))
+		return NULL;
+
+	uint32_t slots = astBankRead32(bank + 0x10);
+	const unsigned char *index = bank + astBankRead32(bank + 0x14);
+	const char *names = (const char*) index + (size_t) slots * AST_BANK_SLOT_SIZE;
+	uint32_t namesSize = astBankRead32(bank + 0x18);
+	uint32_t hash = astBankHash(name);
+
+	for (uint32_t x = 0; x < slots; ++x) {
+		const unsigned char *slot = index + ((hash + x) & (slots - 1)) * AST_BANK_SLOT_SIZE;
+		uint32_t slotSize = astBankRead32(slot + 0x08);
+		if (slotSize == 0)
+			break;
+		uint32_t nameOffset = astBankRead32(slot + 0x0C);
+		if (astBankRead32(slot) == hash && nameOffset < namesSize && memchr(names + nameOffset, 0, namesSize - nameOffset) && astBankNameEqual(names + nameOffset, name)) {
+			uint32_t offset = astBankRead32(slot + 0x04);
+			if ((uint64_t) offset + slotSize > bankSize)
+				return NULL;
+			if (size)
+				*size = slotSize;
+			return bank + offset;
+		}
+	}
+	return NULL;
+}
+
+// Read-only memory mapping of a bank file
+struct ASTBankView {
+	const unsigned char *data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file;
+#endif
+};
+
+// Closes a bank previously opened with astBankOpen
+static inline void astBankClose(ASTBankView *view) {
+#ifdef _WIN32
+	if (view->data)
+		UnmapViewOfFile(view->data);
+	if (view->mapping)
+		CloseHandle(view->mapping);
+	if (view->file != INVALID_HANDLE_VALUE)
+		CloseHandle(view->file);
+	view->mapping = NULL;
+	view->file = INVALID_HANDLE_VALUE;
+#else
+	if (view->data)
+		munmap((void*) view->data, view->size);
+	if (view->file >= 0)
+		close(view->file);
+	view->file = -1;
+#endif
+	view->data = NULL;
+	view->size = 0;
+}
+
+// Maps a bank file into memory (returns 0 on success)
+static inline int astBankOpen(ASTBankView *view, const char *path) {
+	view->data = NULL;
+	view->size = 0;
+#ifdef _WIN32
+	view->mapping = NULL;
+	view->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (view->file == INVALID_HANDLE_VALUE)
+		return 1;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(view->file, &fileSize) || fileSize.QuadPart == 0 || (uint64_t) fileSize.QuadPart > (size_t) -1) {
+		astBankClose(view);
+		return 1;
+	}
+	view->size = (size_t) fileSize.QuadPart;
+
+	view->mapping = CreateFileMappingA(view->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (view->mapping)
+		view->data = (const unsigned char*) MapViewOfFile(view->mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	view->file = open(path, O_RDONLY);
+	if (view->file < 0)
+		return 1;
+
+	struct stat st;
+	if (fstat(view->file, &st) != 0 || st.st_size == 0) {
+		astBankClose(view);
+		return 1;
+	}
+	view->size = (size_t) st.st_size;
+
+	void *data = mmap(NULL, view->size, PROT_READ, MAP_SHARED, view->file, 0);
+	if (data != MAP_FAILED)
+		view->data = (const unsigned char*) data;
+#endif
+	if (!view->data || !astBankValid(view->data, view->size)) {
+		astBankClose(view);
+		return 1;
+	}
+	return 0;
+}
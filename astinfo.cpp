@@ -0,0 +1,190 @@
+// astinfo.cpp : AST layout and block conversion shared by every way of producing an AST
+//
+// Nothing here opens files or needs windows.h, so the streaming encoder (encoder.h) links with this file and encoder.cpp alone.
+
+#include "stdafx.h"
+#include "main.h"
+#include <string>
+#include <intrin.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+using namespace std;
+
+string help; // Stores help text (set by main)
+string shortFilename; // Shortened filename used with help text (set by main)
+
+// Prints a message, or collects it instead while a batch is being checked
+void ASTInfo::report(const char *format, ...) {
+	// Measures the message first, since some messages carry the whole help text
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	if (length < 0)
+		return;
+	string message(length + 1, '\0');
+	va_start(args, format);
+	vsnprintf(&message[0], message.size(), format, args);
+	va_end(args);
+	message.resize(length);
+
+	if (this->messages)
+		*this->messages += message;
+	else
+		printf("%s", message.c_str());
+}
+
+// Calculates AST layout and checks settings for errors
+int ASTInfo::validateAST() {
+	// Shortens AST to whatever is left of the source audio after the starting point
+	if (this->beginSample >= this->srcSamples) {
+		report("ERROR: Starting point of AST is at or beyond the end of the source audio!\n");
+		return 1;
+	}
+	if (this->numSamples > this->srcSamples - this->beginSample) {
+		this->numSamples = this->srcSamples - this->beginSample;
+		this->wavSize = this->numSamples * 2 * this->numChannels;
+	}
+
+	// Calculates number of blocks and size of last block
+	this->excBlkSz = (this->numSamples * 2) % this->blockSize;
+	this->numBlocks = (this->numSamples * 2) / this->blockSize;
+	if (this->excBlkSz != 0)
+		this->numBlocks++;
+	this->padding = 32 - (this->excBlkSz % 32);
+	if (this->padding == 32)
+		this->padding = 0;
+
+	// Ensures resulting file size isn't too large
+	if ((uint64_t) wavSize + (uint64_t) (this->numBlocks * 32) + (uint64_t) (this->padding * this->numChannels) >= 4294967232) {
+		report("ERROR: Input file is too large!\n");
+		return 1;
+	}
+
+	this->astSize = wavSize + (this->numBlocks * 32) + (this->padding * this->numChannels); // Stores size of AST
+
+	// Ensures output file extension is .ast
+	string tmp = "";
+	if (this->filename.length() >= 4)
+		tmp = this->filename.substr(this->filename.length() - 4, this->filename.length());
+	if (_strcmpi(tmp.c_str(), ".ast") != 0)
+		this->filename += ".ast";
+	if (_strcmpi(this->filename.c_str(), ".ast") == 0) {
+		report("ERROR: Output filename can not be restricted exclusively to .ast extension!\n\n%s", this->messages ? "" : help.c_str());
+		return 1;
+	}
+
+	// Ensures WAV file has audio
+	if (this->numBlocks == 0) {
+		report("ERROR: Source WAV contains no audio data!\n");
+		return 1;
+	}
+
+	// Compensates by setting extra block size to the general block size if it's set to zero
+	if (this->excBlkSz == 0)
+		this->excBlkSz = this->blockSize;
+
+	// Prevents starting loop point from being as large or larger than the end point
+	if (this->loopStart >= this->numSamples) {
+		if (this->isLooped != 0 && this->loopStart != 0)
+			report("WARNING: Starting loop point (%d) is not before the end of the stream (%d).  Loop will start at 0 instead.\n", this->loopStart, this->numSamples);
+		this->loopStart = 0;
+	}
+
+	// Checks to make sure sample rate is not zero
+	if (this->customSampleRate == 0) {
+		report("ERROR: Source file has a sample rate of 0 Hz!\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+// Returns offset of a block within the AST file
+uint64_t ASTInfo::blockOffset(unsigned int x) {
+	return 64 + (uint64_t) x * (32 + this->blockSize * this->numChannels);
+}
+
+// Returns index of the block containing an offset of the AST file (offset must be past the header)
+unsigned int ASTInfo::blockAt(uint64_t offset) {
+	uint64_t x = (offset - 64) / (32 + this->blockSize * this->numChannels);
+	return x < this->numBlocks ? (unsigned int) x : this->numBlocks - 1;
+}
+
+// Builds the 64-byte AST header in memory (and swaps endianness)
+void ASTInfo::buildHeader(unsigned char *header) {
+	memcpy(&header[0x0000], "STRM", 4*sizeof(char)); // Prints "STRM" at 0x0000
+
+	uint32_t fourByteInt = _byteswap_ulong(this->astSize); // Prints total size of all future AST block chunks (file size - 64) at 0x0004
+	memcpy(&header[0x0004], &fourByteInt, sizeof(fourByteInt));
+
+	fourByteInt = 268435712; // Prints a hex of 0x00010010 at 0x0008 (contains PCM16 encoding information)
+	memcpy(&header[0x0008], &fourByteInt, sizeof(fourByteInt));
+
+	uint16_t twoByteShort = _byteswap_ushort(this->numChannels); // Prints number of channels at 0x000C
+	memcpy(&header[0x000C], &twoByteShort, sizeof(twoByteShort));
+
+	memcpy(&header[0x000E], &this->isLooped, sizeof(this->isLooped)); // Prints 0xFFFF if looped and 0x0000 if not looped at 0x000E
+
+	fourByteInt = _byteswap_ulong(this->customSampleRate); // Prints sample rate at 0x0010
+	memcpy(&header[0x0010], &fourByteInt, sizeof(fourByteInt));
+
+	fourByteInt = _byteswap_ulong(this->numSamples); // Prints total number of samples at 0x0014
+	memcpy(&header[0x0014], &fourByteInt, sizeof(fourByteInt));
+
+	fourByteInt = _byteswap_ulong(this->loopStart); // Prints starting loop point (in samples) at 0x0018
+	memcpy(&header[0x0018], &fourByteInt, sizeof(fourByteInt));
+
+	fourByteInt = _byteswap_ulong(this->numSamples); // Prints end loop point (in samples) at 0x001C (same as 0x0014)
+	memcpy(&header[0x001C], &fourByteInt, sizeof(fourByteInt));
+
+	// Prints size of first block at 0x0020
+	if (this->numBlocks == 1) {
+		fourByteInt = _byteswap_ulong(this->excBlkSz + padding);
+	}
+	else {
+		fourByteInt = _byteswap_ulong(this->blockSize);
+	}
+	memcpy(&header[0x0020], &fourByteInt, sizeof(fourByteInt));
+
+	// Fills in last 28 bytes with all 0s (except for 0x0028, which has a hex of 0x7F)
+	memset(&header[0x0024], 0, 28);
+	header[0x0028] = 127; // Likely denotes playback volume of AST (always set to 127, or 0x7F)
+
+	return;
+}
+
+// Converts one block worth of interleaved source audio into an AST block (Big Endian) and returns its size in bytes
+unsigned int ASTInfo::buildBlock(unsigned int x, const uint16_t *source, unsigned char *output) {
+	uint32_t length = this->blockSize; // Stores size of audio chunk in block
+	uint32_t paddedLength = this->blockSize; // Stores current block size along with padding
+	unsigned short offset = this->numChannels; // Stores an offset used in for loops to compensate with variable channels
+	uint16_t *printBlock = (uint16_t*) &output[32]; // Stores all finalized audio data of the block
+	unsigned int blockIndex = 0; // Used for indexing the location of data in the printBlock array
+
+	// Adds padding to paddedLength during the last block
+	if (x == this->numBlocks - 1) {
+		length = this->excBlkSz;
+		paddedLength = this->excBlkSz + this->padding;
+	}
+	length *= this->numChannels; // Changes length from block size to audio size
+
+	// Writes block header
+	memcpy(&output[0x0000], "BLCK", 4*sizeof(char)); // Writes "BLCK" at 0x0000 index of block
+	uint32_t fourByteInt = _byteswap_ulong(paddedLength); // Writes block size at 0x0004 index of block
+	memcpy(&output[0x0004], &fourByteInt, sizeof(fourByteInt));
+	memset(&output[0x0008], 0, 24); // Writes 24 bytes worth of 0s at 0x0008 index of block
+
+	for (unsigned int y = 0; y < this->numChannels; ++y) {
+		unsigned int z = y;
+		for (z; z < length / 2; z += offset) // Rearranges audio data in channel order to printBlock and swaps endianness
+			printBlock[blockIndex++] = _byteswap_ushort(source[z]);
+
+		if (x == this->numBlocks - 1) { // Adds 32-byte padding to the end of the stream
+			for (z = 0; z < padding; z += 2)
+				printBlock[blockIndex++] = 0;
+		}
+	}
+	return 32 + blockIndex * sizeof(uint16_t);
+}
@@ -0,0 +1,41 @@
+/**
+ * AST job protocol
+ *
+ * Lets another process on the same machine hand finished PCM audio to a running AST creator (ASTCreate.exe -p [pipe name]) without writing a WAV file first.
+ *
+ * The client sends one ASTJob message over the named pipe \\.\pipe\[pipe name] and then waits for one ASTJobResult message.
+ * Rather than sending any audio, the job names two handles that are open in the client process:
+ *	sourceHandle  a file mapping (ex: CreateFileMapping on INVALID_HANDLE_VALUE) holding interleaved 16-bit Little Endian PCM, readable with FILE_MAP_READ
+ *	outputHandle  a file opened with GENERIC_WRITE that the AST gets written to from the beginning
+ *
+ * The server duplicates both handles out of the client process (the client is identified by the pipe, not by the message), maps the source audio directly and writes the AST straight into the output file.
+ * Handles only need to stay open until the result has been received.  Only clients on the local machine are accepted.
+ * The server takes one client at a time, so a client that connects must send its whole ASTJob within 5 seconds, and read the result within 5 seconds of it being sent, or it is disconnected.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define AST_JOB_VERSION 1
+
+// Sent by the client
+struct ASTJob {
+	char magic[4]; // "ASTJ"
+	uint32_t version; // AST_JOB_VERSION
+	uint64_t sourceHandle; // Handle of file mapping holding source audio (in client process)
+	uint64_t sourceOffset; // Offset of the first sample frame within the file mapping
+	uint64_t outputHandle; // Handle of file the AST gets written to (in client process)
+	uint32_t numChannels; // Number of channels (1-16)
+	uint32_t sampleRate; // Sample rate written to the AST
+	uint32_t numSamples; // Number of sample frames to convert
+	uint32_t loopStart; // Starting loop point (in samples)
+	uint32_t isLooped; // 1 if the AST is looped, 0 if not
+	char name[260]; // Name of the stream used in server messages (optional)
+};
+
+// Sent back by the server
+struct ASTJobResult {
+	uint32_t status; // 0 on success, 1 on failure
+	char message[256]; // Description of the result
+};
@@ -0,0 +1,299 @@
+// bank.cpp : writes AST files into bank files (.astb) and extracts them again
+//
+// See astbank.h for the layout of a bank file.
+
+#include "stdafx.h"
+#include "main.h"
+#include "astbank.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <intrin.h>
+#include <stdio.h>
+#include <windows.h>
+
+using namespace std;
+
+// Stores a single stream entry of the bank index
+struct BankEntry {
+	uint32_t nameHash;
+	uint32_t offset;
+	uint32_t size;
+	string name;
+};
+
+// Stores a range of the bank file that is in use
+struct BankRegion {
+	uint64_t offset;
+	uint64_t end;
+};
+
+// Rounds a value up to a multiple of alignment
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Finds the first aligned spot after the header where size bytes fit without touching any region in use
+static uint64_t findSpace(vector<BankRegion> used, uint64_t size, uint64_t alignment) {
+	sort(used.begin(), used.end(), [](const BankRegion &a, const BankRegion &b) { return a.offset < b.offset; });
+	uint64_t position = AST_BANK_HEADER_SIZE;
+	for (unsigned int x = 0; x < used.size(); ++x) {
+		if (alignUp(position, alignment) + size <= used[x].offset)
+			break;
+		if (used[x].end > position)
+			position = used[x].end;
+	}
+	return alignUp(position, alignment);
+}
+
+// Adds the AST to a bank file instead of writing a standalone AST
+int ASTInfo::writeBank(FILE *sourceWAV) {
+	uint32_t alignment = this->bankAlignment; // Alignment of stream images
+	uint32_t indexOffset = 0; // Offset of index
+	uint32_t indexSize = 0; // Size of index along with its name table
+	uint32_t numSlots = 0; // Number of slots in index
+	vector<BankEntry> entries; // Streams already stored in the bank
+
+	// Creates directory if needed
+	if (this->bankFilename.find("\\") != string::npos || this->bankFilename.find("/") != string::npos) {
+		int size = this->bankFilename.find_last_of("/\\");
+		CreateDirectory(this->bankFilename.substr(0, size+1).c_str(), NULL);
+	}
+
+	// Opens existing bank and reads its index, or creates a new bank
+	FILE *bank = fopen(this->bankFilename.c_str(), "r+b");
+	if (bank) {
+		unsigned char header[AST_BANK_HEADER_SIZE];
+		_fseeki64(bank, 0, SEEK_END);
+		uint64_t bankSize = _ftelli64(bank);
+		_fseeki64(bank, 0, SEEK_SET);
+
+		// Only the header is read here, so the size passed along is that of the whole file
+		if (fread(header, sizeof(header), 1, bank) != 1 || !astBankValid(header, (size_t) bankSize)) {
+			printf("ERROR: Bank file \"%s\" is invalid, corrupted or was made by a different version!\n", this->bankFilename.c_str());
+			fclose(bank);
+			return 1;
+		}
+		alignment = astBankRead32(header + 0x08);
+		numSlots = astBankRead32(header + 0x10);
+		indexOffset = astBankRead32(header + 0x14);
+		uint32_t namesSize = astBankRead32(header + 0x18);
+		indexSize = numSlots * AST_BANK_SLOT_SIZE + namesSize;
+		if (this->bankAlignment != 32 && this->bankAlignment != alignment)
+			printf("WARNING: Bank already uses an alignment of %d bytes.  Alignment argument will be ignored.\n", alignment);
+
+		vector<unsigned char> index(indexSize + 1, 0); // Extra 0 ends the last name even if the name table is corrupted
+		_fseeki64(bank, indexOffset, SEEK_SET);
+		if (indexSize != 0 && fread(&index[0], indexSize, 1, bank) != 1) {
+			printf("ERROR: Bank file \"%s\" is invalid or corrupted!\n", this->bankFilename.c_str());
+			fclose(bank);
+			return 1;
+		}
+		const char *names = (const char*) &index[numSlots * AST_BANK_SLOT_SIZE];
+		for (uint32_t x = 0; x < numSlots; ++x) {
+			const unsigned char *slot = &index[x * AST_BANK_SLOT_SIZE];
+			uint32_t nameOffset = astBankRead32(slot + 0x0C);
+			BankEntry entry = { astBankRead32(slot), astBankRead32(slot + 0x04), astBankRead32(slot + 0x08), "" };
+			if (entry.size == 0)
+				continue;
+			if (nameOffset >= namesSize) {
+				printf("ERROR: Bank file \"%s\" is invalid or corrupted!\n", this->bankFilename.c_str());
+				fclose(bank);
+				return 1;
+			}
+			entry.name = names + nameOffset;
+			entries.push_back(entry);
+		}
+	}
+	else {
+		bank = fopen(this->bankFilename.c_str(), "w+b");
+		if (!bank) {
+			printf("ERROR: Couldn't create bank file.\n");
+			return 1;
+		}
+	}
+
+	// Finds a stream with the same name to replace
+	string streamName = this->filename.substr(this->filename.find_last_of("/\\") + 1);
+	uint32_t nameHash = astBankHash(streamName.c_str());
+	uint32_t imageSize = this->astSize + 64;
+	int entryIndex = -1;
+	for (unsigned int x = 0; x < entries.size(); ++x) {
+		if (astBankNameEqual(entries[x].name.c_str(), streamName.c_str())) {
+			entryIndex = x;
+			entries[x].name = streamName; // Replaced stream takes on the new spelling of its name
+			break;
+		}
+	}
+
+	// Finds space in use by streams and the index (the old image of a replaced stream stays intact until the header points elsewhere)
+	vector<BankRegion> used;
+	for (unsigned int x = 0; x < entries.size(); ++x) {
+		BankRegion region = { entries[x].offset, (uint64_t) entries[x].offset + entries[x].size };
+		used.push_back(region);
+	}
+	if (indexSize != 0) {
+		BankRegion region = { indexOffset, (uint64_t) indexOffset + indexSize };
+		used.push_back(region);
+	}
+
+	// Adds an index entry for a new stream
+	if (entryIndex == -1) {
+		BankEntry newEntry = { nameHash, 0, imageSize, streamName };
+		entries.push_back(newEntry);
+	}
+
+	// Grows index so that it is never more than half full
+	uint32_t newNumSlots = numSlots < 16 ? 16 : numSlots;
+	while (newNumSlots < entries.size() * 2)
+		newNumSlots *= 2;
+	uint64_t namesSize = 0;
+	for (unsigned int x = 0; x < entries.size(); ++x)
+		namesSize += entries[x].name.length() + 1;
+	uint64_t newIndexSize = (uint64_t) newNumSlots * AST_BANK_SLOT_SIZE + namesSize;
+
+	// Places stream image and new index in unused space only
+	uint64_t imageOffset = findSpace(used, imageSize, alignment);
+	BankRegion imageRegion = { imageOffset, imageOffset + imageSize };
+	used.push_back(imageRegion);
+	uint64_t newIndexOffset = findSpace(used, newIndexSize, 32);
+
+	// Ensures resulting bank isn't too large
+	if (imageOffset + imageSize > 4294967295 || newIndexOffset + newIndexSize > 4294967295) {
+		printf("ERROR: Bank file would be too large!\n");
+		fclose(bank);
+		return 1;
+	}
+
+	printInfo(); // Prints AST information to user
+
+	printf("\n\nAdding %s to %s...", streamName.c_str(), this->bankFilename.c_str());
+	if (entryIndex != -1)
+		printf("(replacing stream with the same name)...");
+
+	// Writes stream image
+	_fseeki64(bank, imageOffset, SEEK_SET);
+	printHeader(bank); // Writes header info to bank
+	printAudio(sourceWAV, bank); // Writes audio to bank
+
+	if (entryIndex == -1)
+		entryIndex = entries.size() - 1;
+	entries[entryIndex].nameHash = nameHash;
+	entries[entryIndex].offset = (uint32_t) imageOffset;
+	entries[entryIndex].size = imageSize;
+
+	// Writes index followed by its name table (Big Endian)
+	vector<uint32_t> index(newNumSlots * (AST_BANK_SLOT_SIZE / 4), 0);
+	string names;
+	for (unsigned int x = 0; x < entries.size(); ++x) {
+		uint32_t slot = entries[x].nameHash & (newNumSlots - 1);
+		while (index[slot * 4 + 2] != 0)
+			slot = (slot + 1) & (newNumSlots - 1);
+		index[slot * 4] = _byteswap_ulong(entries[x].nameHash);
+		index[slot * 4 + 1] = _byteswap_ulong(entries[x].offset);
+		index[slot * 4 + 2] = _byteswap_ulong(entries[x].size);
+		index[slot * 4 + 3] = _byteswap_ulong((uint32_t) names.length());
+		names.append(entries[x].name.c_str(), entries[x].name.length() + 1);
+	}
+	_fseeki64(bank, newIndexOffset, SEEK_SET);
+	fwrite(&index[0], index.size() * sizeof(uint32_t), 1, bank);
+	fwrite(names.data(), names.length(), 1, bank);
+
+	// Writes bank header last, only once everything it points to is in place
+	if (fflush(bank) != 0 || ferror(bank)) {
+		printf("\nERROR: Couldn't write to bank file.  The bank has been left as it was.\n");
+		fclose(bank);
+		return 1;
+	}
+	uint32_t header[AST_BANK_HEADER_SIZE / 4] = { 0 };
+	memcpy(&header[0], "ASTB", 4);
+	header[1] = _byteswap_ulong(AST_BANK_VERSION);
+	header[2] = _byteswap_ulong(alignment);
+	header[3] = _byteswap_ulong((uint32_t) entries.size());
+	header[4] = _byteswap_ulong(newNumSlots);
+	header[5] = _byteswap_ulong((uint32_t) newIndexOffset);
+	header[6] = _byteswap_ulong((uint32_t) names.length());
+	_fseeki64(bank, 0, SEEK_SET);
+	fwrite(&header[0], sizeof(header), 1, bank);
+
+	if (fclose(bank) != 0) {
+		printf("\nERROR: Couldn't write to bank file.\n");
+		return 1;
+	}
+	printf("...DONE!\n");
+	return 0;
+}
+
+// Extracts a single AST from a bank file
+int extractBank(int argc, char **argv) {
+	string bankFilename = argv[1];
+	string streamName = "";
+	string outputFilename = "";
+
+	// Parses through user arguments
+	for (int count = 2; count < argc; count++) {
+		if (strcmp(argv[count], "-h") == 0) {
+			printf(help.c_str());
+		}
+		else if (strcmp(argv[count], "-x") == 0 && count + 1 < argc) {
+			streamName = argv[++count];
+		}
+		else if (strcmp(argv[count], "-o") == 0 && count + 1 < argc) {
+			outputFilename = argv[++count];
+		}
+		else {
+			printf(help.c_str());
+			return 1;
+		}
+	}
+	if (streamName.empty()) {
+		printf("ERROR: No stream name given!  Use -x to choose which stream to extract from the bank.\n\n%s", help.c_str());
+		return 1;
+	}
+
+	// Stream names always carry the .ast extension
+	if (streamName.length() < 4 || _strcmpi(streamName.substr(streamName.length() - 4, 4).c_str(), ".ast") != 0)
+		streamName += ".ast";
+	streamName = streamName.substr(streamName.find_last_of("/\\") + 1);
+
+	// Defaults to the stream name in the same directory as the bank, or inside the output directory if one was given
+	if (outputFilename.empty())
+		outputFilename = bankFilename.substr(0, bankFilename.find_last_of("/\\") + 1);
+	if (outputFilename.empty() || outputFilename.find_last_of("/\\") + 1 == outputFilename.length())
+		outputFilename += streamName;
+
+	ASTBankView view;
+	if (astBankOpen(&view, bankFilename.c_str()) != 0) {
+		printf("ERROR: Bank file \"%s\" is invalid or corrupted!\n", bankFilename.c_str());
+		return 1;
+	}
+
+	uint32_t imageSize = 0;
+	const unsigned char *image = astBankFind(view.data, view.size, streamName.c_str(), &imageSize);
+	if (!image) {
+		printf("ERROR: Stream \"%s\" could not be found in bank!\n", streamName.c_str());
+		astBankClose(&view);
+		return 1;
+	}
+
+	// Creates directory if needed
+	if (outputFilename.find("\\") != string::npos || outputFilename.find("/") != string::npos) {
+		int size = outputFilename.find_last_of("/\\");
+		CreateDirectory(outputFilename.substr(0, size+1).c_str(), NULL);
+	}
+
+	FILE *outputAST = fopen(outputFilename.c_str(), "wb");
+	if (!outputAST) {
+		printf("ERROR: Couldn't create file.\n");
+		astBankClose(&view);
+		return 1;
+	}
+
+	printf("Extracting %s from %s (%d bytes)...", streamName.c_str(), bankFilename.c_str(), imageSize);
+	fwrite(image, imageSize, 1, outputAST);
+	printf("...DONE!\n");
+
+	fclose(outputAST);
+	astBankClose(&view);
+	return 0;
+}
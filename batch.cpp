@@ -0,0 +1,172 @@
+// batch.cpp : converts every file matching a wildcard input
+//
+// All headers are checked (in parallel) before the first AST is written, so that one bad file cannot leave a batch half converted.
+
+#include "stdafx.h"
+#include "main.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <windows.h>
+
+using namespace std;
+
+// Stores everything known about a single file of the batch
+struct BatchItem {
+	string input; // Path of source WAV file
+	ASTInfo info; // AST settings found while checking
+	string messages; // Errors and warnings found while checking
+	int exit = 0; // 1 if the file can not be converted
+};
+
+// Returns a key that is equal for any two ASTs that would end up in the same place
+static string outputKey(const string &filename, const string &bankFilename) {
+	string path = filename;
+	if (!bankFilename.empty()) // Streams in a bank are told apart by their name only
+		path = "bank stream " + path.substr(path.find_last_of("/\\") + 1);
+
+	for (unsigned int x = 0; x < path.length(); ++x) {
+		if (path[x] == '/')
+			path[x] = '\\';
+		else if (path[x] >= 'A' && path[x] <= 'Z')
+			path[x] += 'a' - 'A';
+	}
+	return path;
+}
+
+// Checks every file matching a wildcard input, then converts them if no problems were found
+int runBatch(int argc, char **argv) {
+	string pattern = argv[1];
+	string directory = pattern.substr(0, pattern.find_last_of("/\\") + 1);
+
+	// Finds every file matching the input
+	vector<string> inputs;
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA(pattern.c_str(), &found);
+	if (search != INVALID_HANDLE_VALUE) {
+		do {
+			if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				inputs.push_back(directory + found.cFileName);
+		} while (FindNextFileA(search, &found));
+		FindClose(search);
+	}
+	if (inputs.empty()) {
+		printf("ERROR: No files match \"%s\"!\n\n%s", pattern.c_str(), help.c_str());
+		return 1;
+	}
+	sort(inputs.begin(), inputs.end());
+
+	for (int count = 2; count < argc; count++) {
+		if (strcmp(argv[count], "-h") == 0)
+			printf(help.c_str());
+	}
+
+	printf("Checking %d files...\n\n", (int) inputs.size());
+
+	// Checks headers and settings of every file in parallel (nothing is written yet)
+	vector<BatchItem> items(inputs.size());
+	atomic<unsigned int> nextItem(0);
+	unsigned int numThreads = thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 1;
+	if (numThreads > items.size())
+		numThreads = items.size();
+
+	vector<thread> workers;
+	for (unsigned int x = 0; x < numThreads; ++x) {
+		workers.push_back(thread([&]() {
+			for (unsigned int y = nextItem++; y < items.size(); y = nextItem++) {
+				BatchItem &item = items[y];
+				item.input = inputs[y];
+				item.info.filename = item.input;
+				item.info.messages = &item.messages;
+
+				FILE *sourceWAV = fopen(item.input.c_str(), "rb");
+				if (!sourceWAV) {
+					item.info.report("ERROR: Cannot find/open input file!\n");
+					item.exit = 1;
+					continue;
+				}
+				item.exit = item.info.readSource(sourceWAV, argc, argv);
+				if (item.exit == 0)
+					item.exit = item.info.validateAST();
+				fclose(sourceWAV);
+			}
+		}));
+	}
+	for (unsigned int x = 0; x < workers.size(); ++x)
+		workers[x].join();
+
+	// Finds files that would overwrite each other once renamed to .ast
+	vector<string> keys(items.size());
+	for (unsigned int x = 0; x < items.size(); ++x) {
+		if (items[x].exit == 1)
+			continue;
+		keys[x] = outputKey(items[x].info.filename, items[x].info.bankFilename);
+		for (unsigned int y = 0; y < x; ++y) {
+			if (items[y].exit == 0 && keys[x] == keys[y]) {
+				if (items[x].info.bankFilename.empty())
+					items[x].info.report("ERROR: Output file %s is also the output of %s!\n", items[x].info.filename.c_str(), items[y].input.c_str());
+				else
+					items[x].info.report("ERROR: Stream name %s is also used by %s in bank %s!\n", items[x].info.filename.substr(items[x].info.filename.find_last_of("/\\") + 1).c_str(), items[y].input.c_str(), items[x].info.bankFilename.c_str());
+				items[x].exit = 2; // Still counts as taken by the first file for other collisions
+				break;
+			}
+		}
+	}
+
+	// Reports every problem together
+	int numFailed = 0;
+	for (unsigned int x = 0; x < items.size(); ++x) {
+		if (items[x].exit != 0)
+			numFailed++;
+		if (items[x].messages.empty())
+			continue;
+		printf("%s:\n", items[x].input.c_str());
+		string &messages = items[x].messages;
+		for (size_t start = 0; start < messages.length();) {
+			size_t end = messages.find('\n', start);
+			if (end == string::npos)
+				end = messages.length();
+			if (end > start)
+				printf("	%s\n", messages.substr(start, end - start).c_str());
+			start = end + 1;
+		}
+		printf("\n");
+	}
+	if (numFailed != 0) {
+		printf("ERROR: %d of %d files can not be converted.  Nothing has been written.\n", numFailed, (int) items.size());
+		return 1;
+	}
+
+	// Serves every file over HTTP instead if requested
+	if (items[0].info.webPort != 0) {
+		vector<ASTInfo> served;
+		for (unsigned int x = 0; x < items.size(); ++x)
+			served.push_back(items[x].info);
+		return runRangeServer(served);
+	}
+
+	// Converts every file
+	int exit = 0;
+	for (unsigned int x = 0; x < items.size(); ++x) {
+		ASTInfo &info = items[x].info;
+		info.messages = NULL;
+
+		printf("%s: ", items[x].input.c_str());
+		FILE *sourceWAV = fopen(items[x].input.c_str(), "rb");
+		if (!sourceWAV) {
+			printf("ERROR: Cannot find/open input file!\n");
+			exit = 1;
+			continue;
+		}
+		if (info.writeAST(sourceWAV) == 1)
+			exit = 1;
+		fclose(sourceWAV);
+		printf("\n");
+	}
+	return exit;
+}
@@ -0,0 +1,105 @@
+// encoder.cpp : streaming AST encoder that never blocks, owns no threads and touches no files (see encoder.h)
+
+#include "stdafx.h"
+#include "encoder.h"
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+using namespace std;
+
+// Starts a new AST from its channels, sample rate, samples, loop start and looping (returns 1 if the settings are invalid)
+int ASTEncoder::begin(unsigned short numChannels, unsigned int sampleRate, unsigned int numSamples, unsigned int loopStart, bool isLooped) {
+	this->info = ASTInfo();
+	this->errors.clear();
+	this->info.messages = &this->errors; // Collects messages instead of printing them
+	this->isStarted = false;
+
+	if (numChannels > 16 || numChannels < 1 || numSamples == 0 || (uint64_t) numSamples * 2 * numChannels >= 4294967232) {
+		this->errors = "ERROR: Invalid number of channels or samples!\n";
+		return 1;
+	}
+	this->info.filename = "stream"; // Only used in messages
+	this->info.numChannels = numChannels;
+	this->info.sampleRate = sampleRate;
+	this->info.customSampleRate = sampleRate;
+	this->info.numSamples = numSamples;
+	this->info.srcSamples = numSamples;
+	this->info.wavSize = numSamples * 2 * numChannels;
+	this->info.loopStart = loopStart;
+	this->info.isLooped = isLooped ? 65535 : 0;
+	int exit = this->info.validateAST();
+	this->info.messages = NULL; // Keeps the encoder safe to copy
+	if (exit == 1)
+		return 1;
+
+	this->source.resize(this->info.blockSize * numChannels);
+	this->output.resize(32 + this->info.blockSize * numChannels);
+	this->sourceFill = 0;
+	this->nextBlock = 0;
+
+	// Header is the first output
+	this->info.buildHeader(&this->output[0]);
+	this->outputSize = 64;
+	this->outputSent = 0;
+	this->isStarted = true;
+	return 0;
+}
+
+// Returns size of source audio in the block being filled
+unsigned int ASTEncoder::blockLength() {
+	return ((this->nextBlock == this->info.numBlocks - 1) ? this->info.excBlkSz : this->info.blockSize) * this->info.numChannels;
+}
+
+// Builds the block being filled once it is complete and the previous output has been consumed
+void ASTEncoder::advance() {
+	if (this->outputSent < this->outputSize || this->nextBlock >= this->info.numBlocks || this->sourceFill < blockLength())
+		return;
+	this->outputSize = this->info.buildBlock(this->nextBlock, (const uint16_t*) &this->source[0], &this->output[0]);
+	this->outputSent = 0;
+	this->sourceFill = 0;
+	this->nextBlock++;
+}
+
+// Adds interleaved frames and returns how many were accepted (only as many as still fit in the block being filled, and none while that block is full and the block before it has not been consumed)
+unsigned int ASTEncoder::push(const int16_t *frames, unsigned int numFrames) {
+	if (!this->isStarted || this->nextBlock >= this->info.numBlocks)
+		return 0;
+	unsigned int frameSize = 2 * this->info.numChannels;
+	unsigned int room = (blockLength() - this->sourceFill) / frameSize;
+	if (numFrames > room)
+		numFrames = room;
+	memcpy(this->source.data() + this->sourceFill, frames, numFrames * frameSize); // Block may already be full, so no element is indexed
+	this->sourceFill += numFrames * frameSize;
+	advance();
+	return numFrames;
+}
+
+// Returns finished bytes that have not been consumed yet (size 0 when more frames are needed)
+const unsigned char *ASTEncoder::pull(unsigned int *size) {
+	*size = this->isStarted ? this->outputSize - this->outputSent : 0;
+	return *size > 0 ? &this->output[this->outputSent] : NULL;
+}
+
+// Marks finished bytes as sent
+void ASTEncoder::consume(unsigned int size) {
+	if (size > this->outputSize - this->outputSent)
+		size = this->outputSize - this->outputSent;
+	this->outputSent += size;
+	advance();
+}
+
+// Returns true once the whole AST has been pulled and consumed
+bool ASTEncoder::isDone() {
+	return this->isStarted && this->nextBlock >= this->info.numBlocks && this->outputSent == this->outputSize;
+}
+
+// Returns size of the whole AST in bytes
+uint64_t ASTEncoder::totalSize() {
+	return this->isStarted ? (uint64_t) this->info.astSize + 64 : 0;
+}
+
+// Returns errors and warnings found by begin
+const string &ASTEncoder::getErrors() {
+	return this->errors;
+}
@@ -0,0 +1,52 @@
+/**
+ * Streaming AST encoder
+ *
+ * Lets a program that drives its own I/O (ex: an event loop) build an AST without the encoder ever blocking, starting threads or touching files.
+ * Audio is pushed in as interleaved 16-bit Little Endian PCM, and the finished AST is pulled out as byte spans to be sent or written however the caller likes.
+ *
+ *	ASTEncoder encoder;
+ *	encoder.begin(2, 32000, numSamples, loopStart, true);
+ *	while (!encoder.isDone()) {
+ *		accepted = encoder.push(samples, framesReady);           // Takes frames until the block being filled is full
+ *		samples += accepted * 2;                                 // Points to int16_t, so it moves by frames * channels
+ *		framesReady -= accepted;
+ *		bytes = encoder.pull(&size);                             // Header first, then each BLCK as soon as it is complete
+ *		encoder.consume(bytesSent);                              // Any amount up to size, whenever the output is ready again
+ *	}
+ *
+ * At most one block of source audio and one finished block are held at a time, so memory stays bounded no matter how long the AST is.
+ * Each encoder is independent, so any number of conversions can be multiplexed on a single thread (see tests/encoder_stress.cpp).
+ * Only encoder.cpp and astinfo.cpp need to be linked, and neither this header nor those files include windows.h.
+ */
+
+#pragma once
+
+#include "main.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class ASTEncoder {
+	ASTInfo info; // AST settings and layout
+	std::string errors; // Errors and warnings found by begin
+
+	std::vector<unsigned char> source; // Stores the source audio of the block being filled
+	unsigned int sourceFill = 0; // Number of bytes of source audio already in the block being filled
+	std::vector<unsigned char> output; // Stores the finished bytes waiting to be pulled
+	unsigned int outputSize = 0; // Number of finished bytes in output
+	unsigned int outputSent = 0; // Number of finished bytes already consumed
+	unsigned int nextBlock = 0; // Index of the block being filled
+	bool isStarted = false; // Stores whether begin succeeded
+
+	unsigned int blockLength(); // Returns size of source audio in the block being filled
+	void advance(); // Builds the block being filled once it is complete and the previous output has been consumed
+
+public:
+	int begin(unsigned short, unsigned int, unsigned int, unsigned int, bool); // Starts a new AST from its channels, sample rate, samples, loop start and looping (returns 1 if the settings are invalid)
+	unsigned int push(const int16_t*, unsigned int); // Adds interleaved frames and returns how many were accepted (only as many as still fit in the block being filled, and none while that block is full and the block before it has not been consumed)
+	const unsigned char *pull(unsigned int*); // Returns finished bytes that have not been consumed yet (size 0 when more frames are needed)
+	void consume(unsigned int); // Marks finished bytes as sent
+	bool isDone(); // Returns true once the whole AST has been pulled and consumed
+	uint64_t totalSize(); // Returns size of the whole AST in bytes
+	const std::string &getErrors(); // Returns errors and warnings found by begin
+};
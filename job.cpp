@@ -0,0 +1,278 @@
+// job.cpp : job server converting audio handed over by other processes (-p), along with the matching client (-j)
+//
+// See astjob.h for the protocol.
+
+#include "stdafx.h"
+#include "main.h"
+#include "astjob.h"
+#include <string>
+#include <io.h>
+#include <stdio.h>
+#include <windows.h>
+
+using namespace std;
+
+#define CLIENT_TIMEOUT 5000 // Milliseconds a connected client may take to send its job, or to take its result
+
+// Converts a job whose handles have been duplicated into this process (takes ownership of the output handle)
+int ASTInfo::writeJob(const ASTJob &job, HANDLE section, HANDLE output, char *message) {
+	this->filename = job.name[0] != '\0' ? string(job.name, strnlen(job.name, sizeof(job.name))) : "job";
+	this->numChannels = (unsigned short) job.numChannels;
+	this->sampleRate = job.sampleRate;
+	this->customSampleRate = job.sampleRate;
+	this->numSamples = job.numSamples;
+	this->srcSamples = job.numSamples;
+	this->loopStart = job.loopStart;
+	this->isLooped = job.isLooped ? 65535 : 0;
+
+	// Ensures job describes something that can be converted
+	if (job.numChannels > 16 || job.numChannels < 1 || (uint64_t) job.numSamples * 2 * job.numChannels >= 4294967232) {
+		sprintf(message, "Invalid number of channels or samples.");
+		CloseHandle(output);
+		return 1;
+	}
+	this->wavSize = this->numSamples * 2 * this->numChannels;
+	if (this->validateAST() == 1) {
+		sprintf(message, "AST settings were rejected (see server output).");
+		CloseHandle(output);
+		return 1;
+	}
+
+	// Maps source audio (views must start on a multiple of the allocation granularity)
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	uint64_t viewStart = job.sourceOffset - job.sourceOffset % systemInfo.dwAllocationGranularity;
+	uint64_t viewSize = job.sourceOffset - viewStart + this->wavSize;
+	const unsigned char *view = NULL;
+	if (viewSize <= (SIZE_T) -1)
+		view = (const unsigned char*) MapViewOfFile(section, FILE_MAP_READ, (DWORD) (viewStart >> 32), (DWORD) viewStart, (SIZE_T) viewSize);
+	if (!view) {
+		sprintf(message, "Couldn't map source audio.  The file mapping may be smaller than the job describes.");
+		CloseHandle(output);
+		return 1;
+	}
+	this->sourceMap = view + (job.sourceOffset - viewStart);
+
+	// Wraps output handle so the usual writing code can be used (closing the FILE closes the handle)
+	int outputDescriptor = _open_osfhandle((intptr_t) output, 0);
+	FILE *outputAST = outputDescriptor == -1 ? NULL : _fdopen(outputDescriptor, "wb");
+	if (!outputAST) {
+		sprintf(message, "Couldn't open output handle for writing.");
+		if (outputDescriptor != -1)
+			_close(outputDescriptor);
+		else
+			CloseHandle(output);
+		UnmapViewOfFile(view);
+		this->sourceMap = NULL;
+		return 1;
+	}
+
+	printInfo(); // Prints AST information to user
+
+	printf("\n\nWriting %s...", this->filename.c_str());
+
+	// Starts at the beginning of the output file (the file pointer is shared with the client, which may have left it anywhere)
+	_fseeki64(outputAST, 0, SEEK_SET);
+
+	printHeader(outputAST); // Writes header info to output
+
+	printAudio(NULL, outputAST); // Writes audio to AST file
+
+	// Cuts off anything left over in the output file
+	bool isWritten = fflush(outputAST) == 0 && !ferror(outputAST) && SetEndOfFile(output);
+
+	fclose(outputAST);
+	UnmapViewOfFile(view);
+	this->sourceMap = NULL;
+
+	if (!isWritten) {
+		printf("...FAILED!\n");
+		sprintf(message, "Couldn't write the AST to the output file (the disk may be full).");
+		return 1;
+	}
+	printf("...DONE!\n");
+	sprintf(message, "Wrote %u bytes.", this->astSize + 64);
+	return 0;
+}
+
+// Handles a single job sent by a connected client
+static int serveJob(HANDLE pipe, const ASTJob &job, ASTJobResult &result) {
+	// Takes over the job's handles from the process on the other end of the pipe
+	ULONG clientID;
+	HANDLE client = NULL;
+	HANDLE section = NULL;
+	HANDLE output = NULL;
+	if (GetNamedPipeClientProcessId(pipe, &clientID))
+		client = OpenProcess(PROCESS_DUP_HANDLE, FALSE, clientID);
+	if (!client
+	  || !DuplicateHandle(client, (HANDLE) (uintptr_t) job.sourceHandle, GetCurrentProcess(), &section, FILE_MAP_READ, FALSE, 0)
+	  || !DuplicateHandle(client, (HANDLE) (uintptr_t) job.outputHandle, GetCurrentProcess(), &output, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+		sprintf(result.message, "Couldn't take over the job's handles (error %lu).", (unsigned long) GetLastError());
+		if (section)
+			CloseHandle(section);
+		if (client)
+			CloseHandle(client);
+		return 1;
+	}
+	CloseHandle(client);
+
+	ASTInfo convertJob; // Creates a class used for storing essential AST data of the job
+	int exit = convertJob.writeJob(job, section, output, result.message);
+	CloseHandle(section);
+	return exit;
+}
+
+// Finishes an overlapped pipe operation, cancelling it if it takes longer than the timeout (returns 1 if it succeeded, 0 if it failed, -1 if it timed out)
+static int finishPipeIO(HANDLE pipe, OVERLAPPED &overlapped, BOOL isDone, DWORD timeout, DWORD *numBytes) {
+	*numBytes = 0;
+	if (!isDone && GetLastError() != ERROR_IO_PENDING)
+		return 0;
+	if (!isDone && WaitForSingleObject(overlapped.hEvent, timeout) != WAIT_OBJECT_0) {
+		CancelIo(pipe);
+		GetOverlappedResult(pipe, &overlapped, numBytes, TRUE); // Waits until the cancelled operation lets go of its buffer
+		return -1;
+	}
+	return GetOverlappedResult(pipe, &overlapped, numBytes, FALSE) ? 1 : 0;
+}
+
+// Waits for jobs from other processes and converts them one at a time
+int runJobServer(const char *name) {
+	string pipeName = "\\\\.\\pipe\\";
+	pipeName += name;
+
+	// Pipe I/O is overlapped so that a client that stalls can be dropped instead of keeping every later client waiting
+	HANDLE event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!event) {
+		printf("ERROR: Couldn't create pipe %s!\n", pipeName.c_str());
+		return 1;
+	}
+	OVERLAPPED overlapped;
+
+	printf("Waiting for jobs on %s (press Ctrl+C to stop)...\n\n", pipeName.c_str());
+
+	while (true) {
+		HANDLE pipe = CreateNamedPipeA(pipeName.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED, PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+			PIPE_UNLIMITED_INSTANCES, sizeof(ASTJobResult), sizeof(ASTJob), 0, NULL);
+		if (pipe == INVALID_HANDLE_VALUE) {
+			printf("ERROR: Couldn't create pipe %s!\n", pipeName.c_str());
+			CloseHandle(event);
+			return 1;
+		}
+
+		// Waits as long as it takes for a client to connect
+		DWORD numBytes = 0;
+		memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.hEvent = event;
+		if (!ConnectNamedPipe(pipe, &overlapped) && GetLastError() != ERROR_PIPE_CONNECTED && finishPipeIO(pipe, overlapped, FALSE, INFINITE, &numBytes) != 1) {
+			CloseHandle(pipe);
+			continue;
+		}
+
+		// Drops a client that doesn't send its whole job in time
+		ASTJob job;
+		ASTJobResult result;
+		memset(&result, 0, sizeof(result));
+		memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.hEvent = event;
+		int isRead = finishPipeIO(pipe, overlapped, ReadFile(pipe, &job, sizeof(job), NULL, &overlapped), CLIENT_TIMEOUT, &numBytes);
+		if (isRead == -1) {
+			printf("Job failed: Client didn't send a whole job within %d seconds.\n\n", CLIENT_TIMEOUT / 1000);
+			DisconnectNamedPipe(pipe);
+			CloseHandle(pipe);
+			continue;
+		}
+		if (isRead == 0 || numBytes != sizeof(job) || memcmp(job.magic, "ASTJ", 4) != 0 || job.version != AST_JOB_VERSION) {
+			result.status = 1;
+			sprintf(result.message, "Job message is invalid or was sent by a different version.");
+		}
+		else {
+			result.status = serveJob(pipe, job, result);
+		}
+		if (result.status != 0)
+			printf("Job failed: %s\n", result.message);
+		printf("\n");
+
+		memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.hEvent = event;
+		if (finishPipeIO(pipe, overlapped, WriteFile(pipe, &result, sizeof(result), NULL, &overlapped), CLIENT_TIMEOUT, &numBytes) == 1) {
+			// Gives the client until the timeout to read the result and close its end (FlushFileBuffers would wait forever on a client that never reads)
+			char unused;
+			memset(&overlapped, 0, sizeof(overlapped));
+			overlapped.hEvent = event;
+			finishPipeIO(pipe, overlapped, ReadFile(pipe, &unused, sizeof(unused), NULL, &overlapped), CLIENT_TIMEOUT, &numBytes);
+		}
+		DisconnectNamedPipe(pipe);
+		CloseHandle(pipe);
+	}
+}
+
+// Hands the conversion to a job server instead of writing the AST itself
+int ASTInfo::submitJob(FILE *sourceWAV) {
+	// Copies source audio into a file mapping, standing in for audio a renderer already has in memory
+	HANDLE section = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, this->wavSize, NULL);
+	void *view = section ? MapViewOfFile(section, FILE_MAP_WRITE, 0, 0, this->wavSize) : NULL;
+	if (!view) {
+		printf("ERROR: Couldn't allocate memory for source audio.\n");
+		if (section)
+			CloseHandle(section);
+		return 1;
+	}
+	size_t numRead = fread(view, this->wavSize, 1, sourceWAV);
+	UnmapViewOfFile(view);
+	if (numRead != 1) {
+		printf("ERROR: Source WAV ends before the end of its audio data!\n");
+		CloseHandle(section);
+		return 1;
+	}
+
+	// Creates directory if needed
+	if (this->filename.find("\\") != string::npos || this->filename.find("/") != string::npos) {
+		int size = this->filename.find_last_of("/\\");
+		CreateDirectory(this->filename.substr(0, size+1).c_str(), NULL);
+	}
+
+	// Creates AST file for the server to write into
+	HANDLE output = CreateFileA(this->filename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (output == INVALID_HANDLE_VALUE) {
+		printf("ERROR: Couldn't create file.\n");
+		CloseHandle(section);
+		return 1;
+	}
+	removeBlockHashes(); // A later -i build must not trust hashes of the AST being replaced
+
+	ASTJob job;
+	memset(&job, 0, sizeof(job));
+	memcpy(job.magic, "ASTJ", 4);
+	job.version = AST_JOB_VERSION;
+	job.sourceHandle = (uint64_t) (uintptr_t) section;
+	job.sourceOffset = 0;
+	job.outputHandle = (uint64_t) (uintptr_t) output;
+	job.numChannels = this->numChannels;
+	job.sampleRate = this->customSampleRate;
+	job.numSamples = this->numSamples;
+	job.loopStart = this->isLooped ? this->loopStart : 0;
+	job.isLooped = this->isLooped ? 1 : 0;
+	strncpy(job.name, this->filename.c_str(), sizeof(job.name) - 1);
+
+	string pipeName = "\\\\.\\pipe\\" + this->jobPipe;
+	printf("Submitting %s to %s...", this->filename.c_str(), pipeName.c_str());
+
+	ASTJobResult result;
+	DWORD numBytes = 0;
+	if (!CallNamedPipeA(pipeName.c_str(), &job, sizeof(job), &result, sizeof(result), &numBytes, NMPWAIT_WAIT_FOREVER) || numBytes != sizeof(result)) {
+		result.status = 1;
+		sprintf(result.message, "Couldn't reach job server (is %s -p %s running?)", shortFilename.c_str(), this->jobPipe.c_str());
+	}
+	result.message[sizeof(result.message) - 1] = '\0';
+
+	CloseHandle(output);
+	CloseHandle(section);
+
+	if (result.status != 0) {
+		DeleteFileA(this->filename.c_str());
+		printf("\nERROR: %s\n", result.message);
+		return 1;
+	}
+	printf("...DONE!  %s\n", result.message);
+	return 0;
+}
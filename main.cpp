@@ -17,59 +17,57 @@
  *	-s [loop start sample]                     (default: 0)
  *	-t [loop start in microseconds]            (ex: 30000000 would be the equivalent of 30 seconds, or 960000 samples with a sample rate of 32000 Hz)
  *	-n                                         (disables looping)
+ *	-i                                         (incremental: rewrites only blocks whose source audio changed since the last -i build, tracked in [output file].blkhash)
  *	-e [loop end sample / total samples]       (default: number of samples in source file)
  *	-f [loop end in microseconds / total time]
+ *	-b [start sample]                          (default: 0 / audio before this point is skipped, loop points and end point are relative to it)
+ *	-c [start in microseconds]
  *	-r [sample rate]                           (default: same as source file / argument intended to change speed of audio rather than size)
+ *	-m [worker threads]                        (default: 1 / 0 uses one per logical processor, workers are spread over NUMA nodes and each converts a contiguous range of blocks)
+ *	-k [bank file]                             (adds the AST to a bank file (.astb) instead of writing a standalone AST)
+ *	-a [bank alignment]                        (default: 32 / alignment of streams in bytes when creating a new bank, must be a multiple of 32)
+ *	-j [pipe name]                             (hands the conversion to a job server started with -p instead of converting here)
+ *	-w [port]                                  (serves the AST at http://localhost:[port]/ instead of writing it, any byte range is built from the source on request)
  *	-h                                         (shows help text)
  *
+ * BANK EXTRACTION
+ *	ASTCreate.exe <bank file> -x [stream name] [-o output file]
+ *
+ * STEM MIX PREVIEW
+ *	ASTCreate.exe <ast file> [-g stem gains] [-o output file]
+ *	-g [stem gains]                            (comma separated gain of each stereo pair of channels, ex: 1,0,0.5 / default: 1 for every stem, stems left out are muted)
+ *	-o [output file]                           (default: same as input with _mix.wav / use - to stream the WAV to stdout)
+ *
+ * JOB SERVER
+ *	ASTCreate.exe -p [pipe name]               (converts audio handed over by other processes through \\.\pipe\[pipe name], see astjob.h)
+ *
  * USAGE EXAMPLES
  *	ASTCreate.exe inputfile.wav -o outputfile.ast -s 158462 -e 7485124
  *	ASTCreate.exe "use quotations if filename contains spaces.wav" -n -f 95000000
+ *	ASTCreate.exe sessionbounce.wav -o cue3.ast -c 95000000 -f 30000000
+ *	ASTCreate.exe "music\*.wav" -o converted\
+ *	ASTCreate.exe "music\*.wav" -w 8080
+ *	ASTCreate.exe inputfile.wav -k level1.astb -a 2048
+ *	ASTCreate.exe level1.astb -x inputfile.ast -o extracted.ast
+ *	ASTCreate.exe dynamic.ast -g 1,0,0.5 -o preview.wav
  * 
  * Note: This program will only work with WAV files (.wav) encoded with 16-bit PCM.  If the source file is anything other than a WAV file, please make a separate conversion first.  Also please ensure the input/output filenames do not contain Unicode characters.
+ * An input file containing wildcards (* or ?) converts every matching file.  All of them are checked first, and nothing is written unless every file can be converted.
  *
  */
 
 
 #include "stdafx.h"
+#include "main.h"
 #include <string>
-#include <intrin.h>
+#include <vector>
 #include <stdio.h>
 #include <windows.h>
 
 using namespace std;
 
-string help; // Stores help text
-string shortFilename; // Shortened filename used with help text
 void defineHelp(char*); // Sets help text
 
-// Used to store essential AST and WAV data
-class ASTInfo {
-	string filename; // Stores filename being used for AST
-	unsigned int customSampleRate; // Stores sample rate used for AST
-	unsigned int sampleRate; // Stores sample rate of original WAV file
-
-	unsigned short numChannels; // Stores number of channels found in original WAV file
-	unsigned int numSamples; // Stores the number of samples being used for the AST
-	unsigned short isLooped = 65535; // Stores value determining whether or not the AST is looped (65535 = true, 0 = false)
-	unsigned int loopStart = 0; // Stores starting loop point
-	unsigned int astSize; // Stores total file size of AST (minus 64)
-	unsigned int wavSize; // Stores size of audio found in source WAV
-
-	unsigned int blockSize = 10080; // Stores block size used (default for AST is 10080 bytes per channel)
-	unsigned int excBlkSz; // Stores the size of the last block being written to the AST file
-	unsigned int numBlocks; // Stores the number of blocks being used in the AST file
-	unsigned int padding; // Stores a value between 0 and 32 to compensate with the final block to round it to a multiple of 32 bytes
-
-public:
-	int grabInfo(int, char**); // Retrieves header info from input WAV file, then later writes new AST file if no errors occur 
-	int getWAVData(FILE*); // Grabs and stores important WAV header info
-	int assignValue(char*, char*); // Parses through user arguments and overrides default settings
-	int writeAST(FILE*); // Entry point for writing the AST file
-	void printHeader(FILE*); // Writes AST header to output file (and swaps endianness)
-	void printAudio(FILE*, FILE*); // Writes all audio data to AST file (Big Endian)
-};
-
 // Main method
 int main(int argc, char **argv)
 {
@@ -105,27 +103,53 @@ void defineHelp(char *arg) {
 		"	-s [loop start sample]                     (default: 0)\n"
 		"	-t [loop start in microseconds]            (ex: 30000000 would be the equivalent of 30 seconds, or 960000 samples with a sample rate of 32000 Hz)\n"
 		"	-n                                         (disables looping)\n"
+		"	-i                                         (incremental: rewrites only blocks whose source audio changed since the last -i build, tracked in [output file].blkhash)\n"
 		"	-e [loop end sample / total samples]       (default: number of samples in source file)\n"
 		"	-f [loop end in microseconds / total time]\n"
+		"	-b [start sample]                          (default: 0 / audio before this point is skipped, loop points and end point are relative to it)\n"
+		"	-c [start in microseconds]\n"
 		"	-r [sample rate]                           (default: same as source file / argument intended to change speed of audio rather than size)\n"
+		"	-m [worker threads]                        (default: 1 / 0 uses one per logical processor, workers are spread over NUMA nodes and each converts a contiguous range of blocks)\n"
+		"	-k [bank file]                             (adds the AST to a bank file (.astb) instead of writing a standalone AST)\n"
+		"	-a [bank alignment]                        (default: 32 / alignment of streams in bytes when creating a new bank, must be a multiple of 32)\n"
+		"	-j [pipe name]                             (hands the conversion to a job server started with -p instead of converting here)\n"
+		"	-w [port]                                  (serves the AST at http://localhost:[port]/ instead of writing it, any byte range is built from the source on request)\n"
 		"	-h                                         (shows help text)\n\n"
+		"BANK EXTRACTION\n	";
+	string s5 = " <bank file> -x [stream name] [-o output file]\n\n"
+		"STEM MIX PREVIEW\n	";
+	string s8 = " <ast file> [-g stem gains] [-o output file]\n"
+		"	-g [stem gains]                            (comma separated gain of each stereo pair of channels, ex: 1,0,0.5 / default: 1 for every stem, stems left out are muted)\n"
+		"	-o [output file]                           (default: same as input with _mix.wav / use - to stream the WAV to stdout)\n\n"
+		"JOB SERVER\n	";
+	string s10 = " -p [pipe name]               (converts audio handed over by other processes through \\\\.\\pipe\\[pipe name], see astjob.h)\n\n"
 		"USAGE EXAMPLES\n	";
 	string s3 = " inputfile.wav -o outputfile.ast -s 158462 -e 7485124\n	";
-	string s4 = " \"use quotations if filename contains spaces.wav\" -n -f 95000000\n\n"
-		"Note: This program will only work with WAV files (.wav) encoded with 16-bit PCM.  If the source file is anything other than a WAV file, please make a separate conversion first.  Also please ensure the input/output filenames do not contain Unicode characters.\n\n";
-
-	help = s1 + str + s2 + str + s3 + str + s4;
+	string s4 = " \"use quotations if filename contains spaces.wav\" -n -f 95000000\n	";
+	string s11 = " sessionbounce.wav -o cue3.ast -c 95000000 -f 30000000\n	";
+	string s12 = " \"music\\*.wav\" -o converted\\\n	";
+	string s13 = " \"music\\*.wav\" -w 8080\n	";
+	string s6 = " inputfile.wav -k level1.astb -a 2048\n	";
+	string s7 = " level1.astb -x inputfile.ast -o extracted.ast\n	";
+	string s9 = " dynamic.ast -g 1,0,0.5 -o preview.wav\n\n"
+		"Note: This program will only work with WAV files (.wav) encoded with 16-bit PCM.  If the source file is anything other than a WAV file, please make a separate conversion first.  Also please ensure the input/output filenames do not contain Unicode characters.\n\n"
+		"An input file containing wildcards (* or ?) converts every matching file.  All of them are checked first, and nothing is written unless every file can be converted.\n\n";
+
+	shortFilename = str;
+	help = s1 + str + s2 + str + s5 + str + s8 + str + s10 + str + s3 + str + s4 + str + s11 + str + s12 + str + s13 + str + s6 + str + s7 + str + s9;
 }
 
 // Retrieves header info from input WAV file, then later writes new AST file if no errors occur 
 int ASTInfo::grabInfo (int argc, char **argv) {
 	this->filename = argv[1];
+
+	// Runs as a job server instead if requested
+	if (this->filename.compare("-p") == 0 && argc == 3)
+		return runJobServer(argv[2]);
 	
-	// Checks for input of more than one input file (via *)
-	if (this->filename.find("*") != -1) {
-		printf("ERROR: Program is only capable of opening a single input file at a time.  Please enter an exact file name (avoid using '*').\n\n%s", help.c_str());
-		return 1;
-	}
+	// Converts every matching file instead if the input contains wildcards
+	if (this->filename.find_first_of("*?") != string::npos)
+		return runBatch(argc, argv);
 
 	// Opens input file
 	FILE *sourceWAV = fopen(this->filename.c_str(), "rb");
@@ -137,26 +161,52 @@ int ASTInfo::grabInfo (int argc, char **argv) {
 		return 1;
 	};
 
+	// Extracts a stream instead if the input is a bank file
+	if (this->filename.length() >= 5 && _strcmpi(this->filename.substr(this->filename.length() - 5, 5).c_str(), ".astb") == 0) {
+		fclose(sourceWAV);
+		return extractBank(argc, argv);
+	}
+
+	// Renders a stem mix instead if the input is an AST file
+	if (this->filename.length() >= 4 && _strcmpi(this->filename.substr(this->filename.length() - 4, 4).c_str(), ".ast") == 0) {
+		fclose(sourceWAV);
+		return renderAST(argc, argv);
+	}
+
+	int exit = this->readSource(sourceWAV, argc, argv); // Grabs WAV header info and applies user arguments
+	if (exit == 1) {
+		fclose(sourceWAV);
+		return 1;
+	}
+
+	exit = this->writeAST(sourceWAV);
+	fclose(sourceWAV);
+	return exit;
+
+}
+
+// Checks input file extension, grabs WAV header info and applies user arguments
+int ASTInfo::readSource(FILE *sourceWAV, int argc, char **argv) {
 	// Checks for file (extention) validity
 	string tmp = "";
 	int wavE = 4; // Allows extention .wave to slide by
 	if (strlen(this->filename.c_str()) >= 4)
 		tmp = this->filename.substr(this->filename.length() - 4, 4);
-	if (tmp.compare(".wav") != 0) {
+	if (_strcmpi(tmp.c_str(), ".wav") != 0) { // Case is ignored like it is when wildcards are matched
 		if (strlen(this->filename.c_str()) >= 5)
 			tmp = this->filename.substr(this->filename.length() - 5, 5);
-		if (tmp.compare(".wave") != 0) { 
+		if (_strcmpi(tmp.c_str(), ".wave") != 0) { 
 			if (this->filename.find(".") != string::npos)
-				printf("ERROR: Source file must be a WAV file!\n\n%s", help.c_str());
+				report("ERROR: Source file must be a WAV file!\n\n%s", this->messages ? "" : help.c_str());
 			else
-				printf("ERROR: Source file contains no extension!  The filename should be followed with \".wav\", assuming the source is indeed a WAV file.\n%s", help.c_str());
-			fclose(sourceWAV);
+				report("ERROR: Source file contains no extension!  The filename should be followed with \".wav\", assuming the source is indeed a WAV file.\n%s", this->messages ? "" : help.c_str());
 			return 1;
 		}
 		wavE = 5;
 	}
 
 	// Changes .wav extension to .ast
+	this->sourceFilename = this->filename;
 	this->filename = this->filename.substr(0, this->filename.length() - wavE);
 	this->filename += ".ast";
 
@@ -169,11 +219,11 @@ int ASTInfo::grabInfo (int argc, char **argv) {
 	for (int count = 2; count < argc; count++) {
 		if (argv[count][0] == '-') {
 			if (strlen(argv[count]) != 2) { // Ensures arguments are two characters
-				printf(help.c_str());
-				return 1;
+				exit = 1;
+				break;
 			}
 			if (argc - 1 == count) {
-				if (argv[count][1] != 'n' && argv[count][1] != 'h')
+				if (argv[count][1] != 'n' && argv[count][1] != 'i' && argv[count][1] != 'h')
 					exit = 1;
 				else
 					exit = assignValue(argv[count], NULL);
@@ -181,7 +231,7 @@ int ASTInfo::grabInfo (int argc, char **argv) {
 			else {
 				exit = assignValue(argv[count], argv[count + 1]);
 			}
-			if (argv[count][1] != 'n' && argv[count][1] != 'h')
+			if (argv[count][1] != 'n' && argv[count][1] != 'i' && argv[count][1] != 'h')
 				count++;
 			else if (argv[count][1] == 'h')
 				helpState = true;
@@ -189,18 +239,20 @@ int ASTInfo::grabInfo (int argc, char **argv) {
 		else {
 			exit = 1;
 		}
-		if (exit == 1) { // Exits the program if user arguments are invalid
+		if (exit == 1) // Stops parsing if user arguments are invalid
+			break;
+	}
+	if (exit == 1) { // Exits the program if user arguments are invalid
+		if (this->messages)
+			report("ERROR: Invalid or incomplete arguments!\n");
+		else
 			printf(help.c_str());
-			return 1;
-		}
+		return 1;
 	}
-	if (helpState == true) // Prints help text if prompted
+	if (helpState == true && !this->messages) // Prints help text if prompted (batches print it only once)
 		printf(help.c_str());
 
-	exit = this->writeAST(sourceWAV);
-	fclose(sourceWAV);
-	return exit;
-
+	return 0;
 }
 
 // Parses through user arguments and overrides default settings
@@ -210,6 +262,7 @@ int ASTInfo::assignValue(char *c1, char *c2) {
 	uint64_t time;
 	long double rounded;
 	uint64_t samples;
+	char *end;
 	string c2str;
 
 	char value = c1[1];
@@ -219,6 +272,9 @@ int ASTInfo::assignValue(char *c1, char *c2) {
 	case 'n': // Disables looping
 		this->isLooped = 0;
 		break;
+	case 'i': // Rewrites only the blocks whose source audio changed since the last build
+		this->isIncremental = true;
+		break;
 	case 'o': // Changes name of output file (if given legal filename)
 		c2str = c2;
 		slash = c2str.find_last_of("/\\");
@@ -230,7 +286,7 @@ int ASTInfo::assignValue(char *c1, char *c2) {
 
 		if (c2str.find("*") != string::npos || c2str.find("?") != string::npos || c2str.find("\"") != string::npos || colon > slash
 		  || c2str.find("<") != string::npos || c2str.find(">") != string::npos || c2str.find("|") != string::npos) {
-			printf("WARNING: Output filename \"%s\" contains illegal format/characters.  Output argument will be ignored.\n", c2);
+			report("WARNING: Output filename \"%s\" contains illegal format/characters.  Output argument will be ignored.\n", c2);
 		}
 		else {
 			if (c2str.find_last_of("/\\") + 1 == c2str.length()) {
@@ -252,10 +308,28 @@ int ASTInfo::assignValue(char *c1, char *c2) {
 		time = (uint64_t) rounded;
 		this->loopStart = (int) rounded;
 		break;
+	case 'b': // Sets starting point of AST within the source audio
+		samples = _strtoui64(c2, &end, 10);
+		if (*c2 < '0' || *c2 > '9' || *end != '\0') {
+			report("ERROR: Invalid starting point \"%s\"!  Please enter a whole number of samples.\n", c2);
+			return 1;
+		}
+		this->beginSample = samples < 4294967295 ? (unsigned int) samples : 4294967295; // Anything past the source is rejected once the source is known
+		break;
+	case 'c': // Sets starting point of AST within the source audio (in microseconds)
+		time = _strtoui64(c2, &end, 10); // Parsed as 64-bit, since microseconds past about 35 minutes don't fit in a long
+		if (*c2 < '0' || *c2 > '9' || *end != '\0') { // Refuses empty, signed and padded values along with trailing characters
+			report("ERROR: Invalid starting point \"%s\"!  Please enter a whole number of microseconds.\n", c2);
+			return 1;
+		}
+		rounded = ((long double) time / 1000000.0);
+		rounded = rounded * (long double) this->sampleRate + 0.5;
+		this->beginSample = rounded < 4294967295.0 ? (unsigned int) rounded : 4294967295; // Anything past the source is rejected once the source is known
+		break;
 	case 'e': // Sets end point of AST file
 		samples = atoi(c2);
 		if (samples == 0) {
-			printf("ERROR: Total number of samples cannot be zero!\n");
+			report("ERROR: Total number of samples cannot be zero!\n");
 			return 1;
 		}
 		if (this->numSamples < (unsigned int) samples)
@@ -267,14 +341,14 @@ int ASTInfo::assignValue(char *c1, char *c2) {
 	case 'f': // Sets end point of AST file (in microseconds)
 		time = atol(c2);
 		if (time == 0) {
-			printf("ERROR: Ending point of AST cannot be set to zero microseconds!\n");
+			report("ERROR: Ending point of AST cannot be set to zero microseconds!\n");
 			return 1;
 		}
 		rounded = ((long double) time / 1000000.0);
 		rounded = rounded * (long double) this->sampleRate + 0.5;
 		samples = (uint64_t) rounded;
 		if (samples == 0) {
-			printf("ERROR: End point of AST is effectively zero!  Please enter a larger value of microseconds (not milliseconds).\n");
+			report("ERROR: End point of AST is effectively zero!  Please enter a larger value of microseconds (not milliseconds).\n");
 			return 1;
 		}
 		if (this->numSamples < (unsigned int) samples)
@@ -283,6 +357,36 @@ int ASTInfo::assignValue(char *c1, char *c2) {
 			this->numSamples = (unsigned int) samples;
 		this->wavSize = this->numSamples * 2 * this->numChannels;
 		break;
+	case 'k': // Adds AST to a bank file instead of writing a standalone AST
+		c2str = c2;
+		if (c2str.length() < 5 || _strcmpi(c2str.substr(c2str.length() - 5, 5).c_str(), ".astb") != 0)
+			c2str += ".astb";
+		this->bankFilename = c2str;
+		break;
+	case 'a': // Sets alignment of streams when creating a new bank
+		this->bankAlignment = atoi(c2);
+		if (this->bankAlignment == 0 || this->bankAlignment % 32 != 0) {
+			report("ERROR: Bank alignment must be a non-zero multiple of 32 bytes!\n");
+			return 1;
+		}
+		break;
+	case 'j': // Hands the conversion to a job server instead of converting here
+		this->jobPipe = c2;
+		break;
+	case 'w': // Serves the AST over HTTP on localhost instead of writing it
+		if (atoi(c2) < 1 || atoi(c2) > 65535) {
+			report("ERROR: Port must be a number between 1 and 65535!\n");
+			return 1;
+		}
+		this->webPort = (unsigned short) atoi(c2);
+		break;
+	case 'm': // Sets number of worker threads converting blocks
+		if (c2[0] < '0' || c2[0] > '9') {
+			report("ERROR: Number of worker threads must be a number (0 uses one per logical processor)!\n");
+			return 1;
+		}
+		this->numWorkers = atoi(c2);
+		break;
 	case 'r': // Sets custom sample rate (does not affect loop times entered, but does intentionally affect playback speed)
 		this->customSampleRate = atoi(c2);
 		if (this->customSampleRate == 0)
@@ -311,7 +415,7 @@ int ASTInfo::getWAVData(FILE *sourceWAV) {
 	riff[4] = '\0';
 	wavefmt[4] = '\0';
 	if (strcmp(_riff, riff) != 0 || strcmp(_wavefmt, wavefmt) != 0) {
-		printf("ERROR: Header contents of WAV are invalid or corrupted.  Please be sure your input file is a RIFF WAV audio file.\n");
+		report("ERROR: Header contents of WAV are invalid or corrupted.  Please be sure your input file is a RIFF WAV audio file.\n");
 		return 1;
 	}
 
@@ -332,7 +436,7 @@ int ASTInfo::getWAVData(FILE *sourceWAV) {
 		fseek(sourceWAV, chunkSZ, SEEK_CUR);
 	}
 	if (!isFmt) {
-		printf("ERROR: No 'fmt ' chunk could be found in WAV file.  The source file is likely corrupted.\n");
+		report("ERROR: No 'fmt ' chunk could be found in WAV file.  The source file is likely corrupted.\n");
 		return 1;
 	}
 
@@ -341,12 +445,13 @@ int ASTInfo::getWAVData(FILE *sourceWAV) {
 	fseek(sourceWAV, 4, SEEK_CUR);
 	fread(&PCM, 2, 1, sourceWAV);
 	if (PCM != 1 && PCM != 65534)
-		printf("CRITICAL WARNING: Source WAV file may not use PCM!\n");
+		report("CRITICAL WARNING: Source WAV file may not use PCM!\n");
 
 	// Ensures source file uses anywhere between 1 and 16 channels total
 	fread(&this->numChannels, 2, 1, sourceWAV);
 	if (this->numChannels > 16 || this->numChannels < 1) {
-		printf("ERROR: Invalid number of channels!  Please stick with a file containing 1-16 channels.\n");
+		report("ERROR: Invalid number of channels!  Please stick with a file containing 1-16 channels.\n");
+		return 1;
 	}
 
 	// Sets sample rate
@@ -358,7 +463,7 @@ int ASTInfo::getWAVData(FILE *sourceWAV) {
 	fseek(sourceWAV, 6, SEEK_CUR);
 	fread(&bitrate, 2, 1, sourceWAV);
 	if (bitrate != 16) {
-		printf("ERROR: Invalid bit rate!  Please make sure you are using 16-bit PCM.\n");
+		report("ERROR: Invalid bit rate!  Please make sure you are using 16-bit PCM.\n");
 		return 1;
 	}
 
@@ -377,13 +482,16 @@ int ASTInfo::getWAVData(FILE *sourceWAV) {
 		fseek(sourceWAV, chunkSZ, SEEK_CUR);
 	}
 	if (!isData) {
-		printf("ERROR: No 'data' chunk could be found in WAV file.  Either the source contains no audio or is corrupted.\n");
+		report("ERROR: No 'data' chunk could be found in WAV file.  Either the source contains no audio or is corrupted.\n");
 		return 1;
 	}
 
 	fread(&this->wavSize, 4, 1, sourceWAV); // Sets total size of audio
 
+	this->dataOffset = _ftelli64(sourceWAV); // Stores where the audio begins
+
 	this->numSamples = (unsigned int) (this->wavSize) / ((unsigned int) this->numChannels * 2); // Sets total number of audio samples
+	this->srcSamples = this->numSamples;
 
 	return 0;
 }
@@ -391,53 +499,26 @@ int ASTInfo::getWAVData(FILE *sourceWAV) {
 // Entry point for writing the AST file
 int ASTInfo::writeAST(FILE *sourceWAV)
 {
-	// Calculates number of blocks and size of last block
-	this->excBlkSz = (this->numSamples * 2) % this->blockSize;
-	this->numBlocks = (this->numSamples * 2) / this->blockSize;
-	if (this->excBlkSz != 0)
-		this->numBlocks++;
-	this->padding = 32 - (this->excBlkSz % 32);
-	if (this->padding == 32)
-		this->padding = 0;
-
-	// Ensures resulting file size isn't too large
-	if ((uint64_t) wavSize + (uint64_t) (this->numBlocks * 32) + (uint64_t) (this->padding * this->numChannels) >= 4294967232) {
-		printf("ERROR: Input file is too large!");
+	// Checks AST settings before anything gets written
+	if (this->validateAST() == 1)
 		return 1;
-	}
 
-	this->astSize = wavSize + (this->numBlocks * 32) + (this->padding * this->numChannels); // Stores size of AST
+	// Seeks straight to the starting point of the AST so that none of the skipped audio is read
+	_fseeki64(sourceWAV, this->dataOffset + (uint64_t) this->beginSample * 2 * this->numChannels, SEEK_SET);
 
-	// Ensures output file extension is .ast
-	string tmp = "";
-	if (this->filename.length() >= 4)
-		tmp = this->filename.substr(this->filename.length() - 4, this->filename.length());
-	if (_strcmpi(tmp.c_str(), ".ast") != 0)
-		this->filename += ".ast";
-	if (_strcmpi(this->filename.c_str(), ".ast") == 0) {
-		printf("ERROR: Output filename can not be restricted exclusively to .ast extension!\n\n%s", help.c_str());
-		return 1;
+	// Serves the AST over HTTP instead if requested
+	if (this->webPort != 0) {
+		vector<ASTInfo> served(1, *this);
+		return runRangeServer(served);
 	}
 
-	// Ensures WAV file has audio
-	if (this->numBlocks == 0) {
-		printf("ERROR: Source WAV contains no audio data!\n");
-		return 1;
-	}
-
-	// Compensates by setting extra block size to the general block size if it's set to zero
-	if (this->excBlkSz == 0)
-		this->excBlkSz = this->blockSize;
-
-	// Prevents starting loop point from being as large or larger than the end point
-	if (this->loopStart >= this->numSamples)
-		this->loopStart = 0;
+	// Adds AST to a bank file instead if requested
+	if (!this->bankFilename.empty())
+		return this->writeBank(sourceWAV);
 
-	// Checks to make sure sample rate is not zero
-	if (this->customSampleRate == 0) {
-		printf("ERROR: Source file has a sample rate of 0 Hz!\n");
-		return 1;
-	}
+	// Hands the conversion to a job server instead if requested
+	if (!this->jobPipe.empty())
+		return this->submitJob(sourceWAV);
 
 	// Creates directory if needed
 	if (this->filename.find("\\") != string::npos || this->filename.find("/") != string::npos) {
@@ -445,14 +526,43 @@ int ASTInfo::writeAST(FILE *sourceWAV)
 		CreateDirectory(this->filename.substr(0, size+1).c_str(), NULL);
 	}
 
+	// Updates the existing AST instead if requested
+	if (this->isIncremental)
+		return this->updateAST(sourceWAV);
+
 	// Creates AST file
 	FILE *outputAST = fopen(this->filename.c_str(), "wb");
 	if (!outputAST) {
 		printf("ERROR: Couldn't create file.\n");
 		return 1;
 	}
+	removeBlockHashes(); // A later -i build must not trust hashes of the AST being replaced
 
-	// Prints AST information to user
+	printInfo(); // Prints AST information to user
+
+	printf("\n\nWriting %s...", this->filename.c_str());
+
+	printHeader(outputAST); // Writes header info to output
+
+	// Writes audio to AST file
+	string stats; // Describes where blocks were converted by worker threads
+	if (this->numWorkers != 1) {
+		if (printAudioParallel(outputAST, stats) == 1) {
+			fclose(outputAST);
+			return 1;
+		}
+	}
+	else {
+		printAudio(sourceWAV, outputAST);
+	}
+
+	printf("...DONE!\n%s", stats.c_str());
+	fclose(outputAST);
+	return 0;
+}
+
+// Prints AST information to user
+void ASTInfo::printInfo() {
 	string loopStatus = "true";
 	if (this->isLooped == 0) {
 		loopStatus = "false";
@@ -465,116 +575,42 @@ int ASTInfo::writeAST(FILE *sourceWAV)
 	printf("File opened successfully!\n\n	AST file size: %d bytes\n	Sample rate: %d Hz\n	Is looped: %s\n", this->astSize + 64, this->customSampleRate, loopStatus.c_str());
 	if (this->isLooped == 65535)
 		printf("	Starting loop point: %d samples (time: %d:%02d.%06d)\n", this->loopStart, (int)(startTime / 60000000), (int)(startTime / 1000000) % 60, (int)(startTime % 1000000));
+	if (this->beginSample != 0) {
+		uint64_t beginTime = (uint64_t) ((long double) this->beginSample / (long double) this->sampleRate * 1000000.0 + 0.5);
+		printf("	Start within source: %d samples (time: %d:%02d.%06d)\n", this->beginSample, (int)(beginTime / 60000000), (int)(beginTime / 1000000) % 60, (int)(beginTime % 1000000));
+	}
 	printf("	End of stream: %d samples (time: %d:%02d.%06d)\n	Number of channels: %d", this->numSamples, (int)(endTime / 60000000), (int)(endTime / 1000000) % 60, (int)(endTime % 1000000), this->numChannels);
 	if (this->numChannels == 1)
 		printf(" (mono)");
 	else if (this->numChannels == 2)
 		printf(" (stereo)");
-
-	printf("\n\nWriting %s...", this->filename.c_str());
-
-	printHeader(outputAST); // Writes header info to output
-
-	printAudio(sourceWAV, outputAST); // Writes audio to AST file
-
-	printf("...DONE!\n");
-	fclose(outputAST);
-	return 0;
 }
 
 // Writes AST header to output file (and swaps endianness)
 void ASTInfo::printHeader(FILE *outputAST) {
-	fwrite("STRM", 4*sizeof(char), 1, outputAST); // Prints "STRM" at 0x0000
-
-	uint32_t fourByteInt = _byteswap_ulong(this->astSize); // Prints total size of all future AST block chunks (file size - 64) at 0x0004
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-
-	fourByteInt = 268435712; // Prints a hex of 0x00010010 at 0x0008 (contains PCM16 encoding information)
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-
-	uint16_t twoByteShort = _byteswap_ushort(this->numChannels); // Prints number of channels at 0x000C
-	fwrite(&twoByteShort, sizeof(twoByteShort), 1, outputAST);
-
-	fwrite(&this->isLooped, sizeof(this->isLooped), 1, outputAST); // Prints 0xFFFF if looped and 0x0000 if not looped at 0x000E
-
-	fourByteInt = _byteswap_ulong(this->customSampleRate); // Prints sample rate at 0x0010
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-
-	fourByteInt = _byteswap_ulong(this->numSamples); // Prints total number of samples at 0x0014
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-
-	fourByteInt = _byteswap_ulong(this->loopStart); // Prints starting loop point (in samples) at 0x0018
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-
-	fourByteInt = _byteswap_ulong(this->numSamples); // Prints end loop point (in samples) at 0x001C (same as 0x0014)
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-
-	// Prints size of first block at 0x0020
-	if (this->numBlocks == 1) {
-		fourByteInt = _byteswap_ulong(this->excBlkSz + padding);
-	}
-	else {
-		fourByteInt = _byteswap_ulong(this->blockSize);
-	}
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-
-	// Fills in last 28 bytes with all 0s (except for 0x0028, which has a hex of 0x7F)
-	fourByteInt = 0;
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-	fourByteInt = 127; // Likely denotes playback volume of AST (always set to 127, or 0x7F)
-	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-	fourByteInt = 0;
-	for (int x = 0; x < 5; ++x)
-		fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputAST);
-
-	return;
+	unsigned char header[64];
+	buildHeader(header);
+	fwrite(header, sizeof(header), 1, outputAST);
 }
 
 // Writes all audio data to AST file (Big Endian)
 void ASTInfo::printAudio(FILE *sourceWAV, FILE *outputAST) {
-	uint32_t length = this->blockSize; // Stores size of audio chunk in block
-	uint32_t paddedLength = _byteswap_ulong(length); // Stores current block size along with padding (Big Endian)
-	const uint16_t zeroPad = 0; // Contains the hex of 0x0000 used for padding
-	unsigned short offset = this->numChannels; // Stores an offset used in for loops to compensate with variable channels
-
 	uint16_t *block = (uint16_t*) malloc(this->blockSize * this->numChannels); // Used to read and store audio data from the original file
-	uint16_t *printBlock = (uint16_t*) malloc(this->blockSize * this->numChannels); // Stores all finalized audio data being printed to AST file
-	const uint64_t headerPad[] = { 0, 0, 0 }; // Used for padding in header
-
-	length *= this->numChannels; // Changes length from block size to audio size
+	unsigned char *printBlock = (unsigned char*) malloc(32 + this->blockSize * this->numChannels); // Stores all finalized block data being printed to AST file
 
 	for (unsigned int x = 0; x < numBlocks; ++x) {
-
-		unsigned int blockIndex = 0; // Used for indexing the location of data in the printBlock array
-
-		// Writes block header
-		fwrite("BLCK", 4*sizeof(char), 1, outputAST); // Writes "BLCK" at 0x0000 index of block
-
-		// Adds padding to paddedLength during the last block
-		if (x == this->numBlocks - 1) {
-			memset(block, 0, this->blockSize * this->numChannels); // Clears old audio data stored in block array (possibly unnecessary)
-			paddedLength = (this->excBlkSz + this->padding);
-			length = (this->excBlkSz) * this->numChannels;
-			paddedLength = _byteswap_ulong(paddedLength);
+		const uint16_t *source = block; // Points to one block worth of interleaved source audio
+		if (this->sourceMap) { // Reads straight from memory mapped source audio
+			source = (const uint16_t*) (this->sourceMap + (uint64_t) x * this->blockSize * this->numChannels);
 		}
-
-		fwrite(&paddedLength, sizeof(paddedLength), 1, outputAST); // Writes block size at 0x0004 index of block
-		fwrite(&headerPad[0], 3*sizeof(uint64_t), 1, outputAST); // Writes 24 bytes worth of 0s at 0x0008 index of block
-
-		fread(&block[0], length, 1, sourceWAV); // Reads one block worth of data from source WAV file
-
-		for (unsigned int y = 0; y < this->numChannels; ++y) {
-			unsigned int z = y;
-			for (z; z < length / 2; z += offset) // Rearranges audio data in channel order to printBlock and swaps endianness
-				printBlock[blockIndex++] = _byteswap_ushort(block[z]);
-
-			if (x == this->numBlocks - 1) { // Adds 32-byte padding to the end of the stream
-				for (z = 0; z < padding; z += 2)
-					printBlock[blockIndex++] = 0;
-			}
+		else {
+			uint32_t length = (x == this->numBlocks - 1) ? this->excBlkSz : this->blockSize;
+			fread(&block[0], length * this->numChannels, 1, sourceWAV); // Reads one block worth of data from source WAV file
 		}
-		fwrite(&printBlock[0], blockIndex*sizeof(uint16_t), 1, outputAST); // Writes processed audio data to output AST file
+
+		unsigned int size = buildBlock(x, source, printBlock);
+		fwrite(&printBlock[0], size, 1, outputAST); // Writes processed block to output AST file
 	}
 	free(block);
 	free(printBlock);
-}
\ No newline at end of file
+}
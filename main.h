@@ -0,0 +1,83 @@
+// main.h : declarations shared between the AST creator's source files
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+
+extern std::string help; // Stores help text
+extern std::string shortFilename; // Shortened filename used with help text
+
+struct ASTJob;
+
+// Used to store essential AST and WAV data
+class ASTInfo {
+	std::string filename; // Stores filename being used for AST
+	std::string sourceFilename; // Stores filename of the source WAV file
+	unsigned int customSampleRate; // Stores sample rate used for AST
+	unsigned int sampleRate; // Stores sample rate of original WAV file
+
+	unsigned short numChannels; // Stores number of channels found in original WAV file
+	unsigned int numSamples; // Stores the number of samples being used for the AST
+	unsigned short isLooped = 65535; // Stores value determining whether or not the AST is looped (65535 = true, 0 = false)
+	unsigned int loopStart = 0; // Stores starting loop point
+	unsigned int astSize; // Stores total file size of AST (minus 64)
+	unsigned int wavSize; // Stores size of audio found in source WAV
+
+	unsigned int blockSize = 10080; // Stores block size used (default for AST is 10080 bytes per channel)
+	unsigned int excBlkSz; // Stores the size of the last block being written to the AST file
+	unsigned int numBlocks; // Stores the number of blocks being used in the AST file
+	unsigned int padding; // Stores a value between 0 and 32 to compensate with the final block to round it to a multiple of 32 bytes
+
+	unsigned int beginSample = 0; // Stores starting point of the AST within the source audio
+	unsigned int srcSamples; // Stores the number of samples found in original WAV file
+	uint64_t dataOffset = 0; // Stores offset of the audio within the source WAV file
+
+	std::string bankFilename; // Stores filename of the bank the AST is added to (empty when writing a standalone AST)
+	unsigned int bankAlignment = 32; // Stores alignment of stream images used when creating a new bank
+
+	std::string jobPipe; // Stores name of the job server pipe the conversion is handed to (empty when converting here)
+	const unsigned char *sourceMap = NULL; // Points to memory mapped source audio (NULL when reading from the source file)
+	std::string *messages = NULL; // Collects messages while a batch is being checked (NULL when printing them right away)
+
+	unsigned int numWorkers = 1; // Stores number of worker threads converting blocks (0 = one per logical processor)
+	bool isIncremental = false; // Stores whether only blocks with changed source audio are rewritten into an existing AST
+	unsigned short webPort = 0; // Stores port the AST is served on over HTTP instead of being written (0 when writing it)
+
+public:
+	int grabInfo(int, char**); // Retrieves header info from input WAV file, then later writes new AST file if no errors occur
+	int readSource(FILE*, int, char**); // Checks input file extension, grabs WAV header info and applies user arguments
+	int getWAVData(FILE*); // Grabs and stores important WAV header info
+	int assignValue(char*, char*); // Parses through user arguments and overrides default settings
+	int writeAST(FILE*); // Entry point for writing the AST file
+	int validateAST(); // Calculates AST layout and checks settings for errors (astinfo.cpp)
+	int writeBank(FILE*); // Adds the AST to a bank file instead of writing a standalone AST (bank.cpp)
+	int updateAST(FILE*); // Updates an existing AST in place, rewriting only the blocks whose source audio changed (update.cpp)
+	bool readBlockHashes(const std::string&, std::vector<uint64_t>&); // Reads the block hashes of the previous build (update.cpp)
+	void removeBlockHashes(); // Removes the block hashes of an AST about to be written in full without -i (update.cpp)
+	int submitJob(FILE*); // Hands the conversion to a job server instead of writing the AST itself (job.cpp)
+	int writeJob(const ASTJob&, void*, void*, char*); // Converts a job handed over by another process, given handles to its audio and output file (job.cpp)
+	void report(const char*, ...); // Prints a message, or collects it instead while a batch is being checked (astinfo.cpp)
+	void printInfo(); // Prints AST information to user
+	void printHeader(FILE*); // Writes AST header to output file (and swaps endianness)
+	void buildHeader(unsigned char*); // Builds the 64-byte AST header in memory (and swaps endianness) (astinfo.cpp)
+	void printAudio(FILE*, FILE*); // Writes all audio data to AST file (Big Endian)
+	int printAudioParallel(FILE*, std::string&); // Converts all audio data on worker threads placed by NUMA node (parallel.cpp)
+	unsigned int buildBlock(unsigned int, const uint16_t*, unsigned char*); // Converts one block worth of interleaved source audio into an AST block (Big Endian) (astinfo.cpp)
+	unsigned int readBlock(FILE*, unsigned int, uint16_t*, unsigned char*); // Reads a single block straight from the source WAV file and converts it (server.cpp)
+	uint64_t blockOffset(unsigned int); // Returns offset of a block within the AST file (astinfo.cpp)
+	unsigned int blockAt(uint64_t); // Returns index of the block containing an offset of the AST file (astinfo.cpp)
+
+	friend int runBatch(int, char**);
+	friend class ASTEncoder;
+	friend int runRangeServer(std::vector<ASTInfo>&);
+};
+
+int extractBank(int, char**); // Extracts a single AST from a bank file (bank.cpp)
+int renderAST(int, char**); // Renders a stereo mix of the stems found in an AST file (render.cpp)
+int runJobServer(const char*); // Waits for jobs from other processes and converts them one at a time (job.cpp)
+int runBatch(int, char**); // Checks every file matching a wildcard input, then converts them if no problems were found (batch.cpp)
+int runRangeServer(std::vector<ASTInfo>&); // Serves virtual AST files over HTTP on localhost until the program is closed (server.cpp)
@@ -0,0 +1,226 @@
+// parallel.cpp : converts blocks on a pool of worker threads placed by NUMA node (-m)
+//
+// The blocks of the AST are split into one contiguous range per NUMA node, sized by the number of workers placed on the node.
+// Workers are pinned to their node and allocate their buffers there, so deinterleaving only ever touches memory local to the node.
+// Each worker reads a few blocks at a time (sized to fit its L2 cache) through its own handle to the source WAV.
+// Workers that run out of blocks help with the ranges of other nodes, which is reported as cross-node traffic.
+
+#include "stdafx.h"
+#include "main.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <windows.h>
+
+using namespace std;
+
+#define DEFAULT_L2_SIZE 262144 // Assumed size of the L2 cache if it can not be found
+
+// Stores a NUMA node along with the range of blocks converted on it
+struct WorkerNode {
+	unsigned short node = 0; // Node number
+	GROUP_AFFINITY affinity; // Processors of the node (a mask of 0 leaves workers unpinned)
+	unsigned int numProcessors = 0; // Number of logical processors of the node
+	unsigned int numWorkers = 0; // Number of workers placed on the node
+	unsigned int firstBlock = 0; // First block of the node's range
+	unsigned int endBlock = 0; // Block following the node's range
+	atomic<unsigned int> nextBlock{0}; // First block of the range not yet taken by a worker
+	atomic<unsigned int> numRemote{0}; // Number of blocks of the range converted on another node
+};
+
+// Counts the processors of an affinity mask
+static unsigned int countProcessors(KAFFINITY mask) {
+	unsigned int count = 0;
+	for (; mask != 0; mask &= mask - 1)
+		count++;
+	return count;
+}
+
+// Reads processor topology of a single kind (returns an empty buffer if it is unavailable)
+static vector<unsigned char> readTopology(LOGICAL_PROCESSOR_RELATIONSHIP relationship) {
+	DWORD length = 0;
+	vector<unsigned char> buffer;
+	if (GetLogicalProcessorInformationEx(relationship, NULL, &length) || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+		return buffer;
+	buffer.resize(length);
+	if (!GetLogicalProcessorInformationEx(relationship, (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*) &buffer[0], &length))
+		buffer.clear();
+	buffer.resize(length);
+	return buffer;
+}
+
+// Returns size of the smallest L2 cache found
+static unsigned int findL2Size() {
+	vector<unsigned char> buffer = readTopology(RelationCache);
+	unsigned int size = 0;
+	for (size_t offset = 0; offset < buffer.size();) {
+		SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*) &buffer[offset];
+		if (info->Relationship == RelationCache && info->Cache.Level == 2 && (size == 0 || info->Cache.CacheSize < size))
+			size = info->Cache.CacheSize;
+		offset += info->Size;
+	}
+	return size != 0 ? size : DEFAULT_L2_SIZE;
+}
+
+// Converts all audio data on a pool of worker threads placed by NUMA node and writes it to the AST file (stats describe where blocks were converted)
+int ASTInfo::printAudioParallel(FILE *outputAST, string &stats) {
+	// Finds every NUMA node with processors (or a single unpinned node if topology is unavailable)
+	vector<unsigned char> topology = readTopology(RelationNumaNode);
+	unsigned int numNodes = 0;
+	for (size_t offset = 0; offset < topology.size(); offset += ((SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*) &topology[offset])->Size)
+		numNodes++;
+	vector<WorkerNode> nodes(numNodes != 0 ? numNodes : 1);
+	unsigned int numProcessors = 0;
+	numNodes = 0;
+	for (size_t offset = 0; offset < topology.size();) {
+		SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*) &topology[offset];
+		offset += info->Size;
+		unsigned int count = countProcessors(info->NumaNode.GroupMask.Mask);
+		if (info->Relationship != RelationNumaNode || count == 0)
+			continue;
+		nodes[numNodes].node = (unsigned short) info->NumaNode.NodeNumber;
+		nodes[numNodes].affinity = info->NumaNode.GroupMask;
+		nodes[numNodes].numProcessors = count;
+		numProcessors += count;
+		numNodes++;
+	}
+	if (numNodes == 0) {
+		memset(&nodes[0].affinity, 0, sizeof(nodes[0].affinity));
+		nodes[0].numProcessors = thread::hardware_concurrency() != 0 ? thread::hardware_concurrency() : 1;
+		numProcessors = nodes[0].numProcessors;
+		numNodes = 1;
+	}
+
+	// Converts a few blocks at a time, keeping the source and finished audio of a batch within the L2 cache
+	unsigned int blockBytes = this->blockSize * this->numChannels;
+	unsigned int batchSize = findL2Size() / (2 * blockBytes + 32);
+	if (batchSize == 0)
+		batchSize = 1;
+
+	// Places workers on nodes by their share of the processors, with no more workers than batches
+	unsigned int numWorkers = this->numWorkers != 0 ? this->numWorkers : numProcessors;
+	if (numWorkers > (this->numBlocks + batchSize - 1) / batchSize)
+		numWorkers = (this->numBlocks + batchSize - 1) / batchSize;
+	unsigned int numPlaced = 0;
+	for (unsigned int x = 0; x < numNodes; ++x) {
+		nodes[x].numWorkers = (unsigned int) ((uint64_t) numWorkers * nodes[x].numProcessors / numProcessors);
+		numPlaced += nodes[x].numWorkers;
+	}
+	for (unsigned int x = 0; numPlaced < numWorkers; x = (x + 1) % numNodes) {
+		nodes[x].numWorkers++;
+		numPlaced++;
+	}
+
+	// Gives each node a contiguous range of blocks matching its share of the workers
+	unsigned int workersBefore = 0;
+	for (unsigned int x = 0; x < numNodes; ++x) {
+		nodes[x].firstBlock = (unsigned int) ((uint64_t) this->numBlocks * workersBefore / numWorkers);
+		workersBefore += nodes[x].numWorkers;
+		nodes[x].endBlock = (unsigned int) ((uint64_t) this->numBlocks * workersBefore / numWorkers);
+		nodes[x].nextBlock = nodes[x].firstBlock;
+	}
+
+	// Opens a handle to the source WAV file for every worker
+	vector<FILE*> sources;
+	for (unsigned int x = 0; x < numWorkers; ++x) {
+		FILE *sourceWAV = fopen(this->sourceFilename.c_str(), "rb");
+		if (!sourceWAV) {
+			printf("\nERROR: Couldn't open %s for worker threads!\n", this->sourceFilename.c_str());
+			for (unsigned int y = 0; y < sources.size(); ++y)
+				fclose(sources[y]);
+			return 1;
+		}
+		sources.push_back(sourceWAV);
+	}
+
+	mutex outputLock; // Keeps workers from writing to the AST file at the same time
+	atomic<bool> isFailed(false);
+	uint64_t audioOffset = this->dataOffset + (uint64_t) this->beginSample * 2 * this->numChannels;
+
+	vector<thread> workers;
+	for (unsigned int x = 0, worker = 0; x < numNodes; ++x) {
+		for (unsigned int y = 0; y < nodes[x].numWorkers; ++y, ++worker) {
+			workers.push_back(thread([&, x, worker]() {
+				WorkerNode &home = nodes[x];
+				FILE *sourceWAV = sources[worker];
+
+				// Pins worker to its node, then allocates (and first touches) its buffers there
+				if (home.affinity.Mask != 0)
+					SetThreadGroupAffinity(GetCurrentThread(), &home.affinity, NULL);
+				SIZE_T bufferSize = (SIZE_T) batchSize * (2 * blockBytes + 32);
+				unsigned char *block = (unsigned char*) VirtualAllocExNuma(GetCurrentProcess(), NULL, bufferSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, home.node);
+				if (!block)
+					block = (unsigned char*) VirtualAlloc(NULL, bufferSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+				if (!block) {
+					isFailed = true;
+					return;
+				}
+				unsigned char *printBlock = block + (SIZE_T) batchSize * blockBytes;
+
+				// Converts the node's own range first, then helps with the ranges of other nodes
+				for (unsigned int z = 0; z < numNodes && !isFailed; ++z) {
+					WorkerNode &range = nodes[(x + z) % numNodes];
+					while (!isFailed) {
+						unsigned int first = range.nextBlock.fetch_add(batchSize);
+						if (first >= range.endBlock)
+							break;
+						unsigned int count = range.endBlock - first < batchSize ? range.endBlock - first : batchSize;
+
+						// Reads source audio of the whole batch at once
+						uint32_t length = (count - 1) * blockBytes + ((first + count == this->numBlocks) ? this->excBlkSz * this->numChannels : blockBytes);
+						if (_fseeki64(sourceWAV, audioOffset + (uint64_t) first * blockBytes, SEEK_SET) != 0 || fread(block, length, 1, sourceWAV) != 1) {
+							isFailed = true;
+							break;
+						}
+
+						// Counts blocks converted away from the node whose range they belong to
+						if (numNodes > 1) {
+							PROCESSOR_NUMBER processor;
+							USHORT currentNode;
+							GetCurrentProcessorNumberEx(&processor);
+							if (GetNumaProcessorNodeEx(&processor, &currentNode) && currentNode != range.node)
+								range.numRemote += count;
+						}
+
+						unsigned int size = 0;
+						for (unsigned int b = 0; b < count; ++b)
+							size += buildBlock(first + b, (const uint16_t*) (block + (SIZE_T) b * blockBytes), printBlock + size);
+
+						lock_guard<mutex> guard(outputLock);
+						_fseeki64(outputAST, blockOffset(first), SEEK_SET);
+						fwrite(printBlock, size, 1, outputAST); // Writes processed batch to output AST file
+					}
+				}
+				VirtualFree(block, 0, MEM_RELEASE);
+			}));
+		}
+	}
+	for (unsigned int x = 0; x < workers.size(); ++x)
+		workers[x].join();
+	for (unsigned int x = 0; x < sources.size(); ++x)
+		fclose(sources[x]);
+
+	if (isFailed) {
+		printf("\nERROR: Worker threads couldn't read the source WAV or allocate memory!\n");
+		return 1;
+	}
+
+	// Describes where blocks were converted
+	char line[256];
+	unsigned int numRemote = 0;
+	sprintf(line, "	Worker threads: %u on %u NUMA node%s (%u blocks per batch)\n", numWorkers, numNodes, numNodes == 1 ? "" : "s", batchSize);
+	stats = line;
+	for (unsigned int x = 0; x < numNodes; ++x) {
+		if (nodes[x].numWorkers == 0)
+			continue;
+		sprintf(line, "	Node %u: %u worker%s, blocks %u-%u (%u converted on other nodes)\n", nodes[x].node, nodes[x].numWorkers, nodes[x].numWorkers == 1 ? "" : "s", nodes[x].firstBlock, nodes[x].endBlock - 1, nodes[x].numRemote.load());
+		stats += line;
+		numRemote += nodes[x].numRemote;
+	}
+	sprintf(line, "	Cross-node blocks: %u of %u\n", numRemote, this->numBlocks);
+	stats += line;
+	return 0;
+}
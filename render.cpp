@@ -0,0 +1,261 @@
+// render.cpp : renders a stereo preview WAV from a mix of the stems in a multi-track AST
+//
+// Every pair of channels in the AST is treated as a stereo stem (an odd last channel is a mono stem played on both sides).
+// Since each BLCK stores every channel as one contiguous run, only the channels of audible stems are ever read.
+
+#include "stdafx.h"
+#include "main.h"
+#include <string>
+#include <vector>
+#include <intrin.h>
+#include <emmintrin.h>
+#include <fcntl.h>
+#include <io.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+using namespace std;
+
+// Reads a Big Endian 32-bit value
+static uint32_t readBE32(const unsigned char *p) {
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+// Swaps endianness of a run of samples, scales them by gain and adds them to the mix
+static void mixRun(const uint16_t *run, float gain, float *mix, unsigned int count) {
+	const __m128 scale = _mm_set1_ps(gain);
+	unsigned int x = 0;
+	for (; x + 8 <= count; x += 8) {
+		__m128i samples = _mm_loadu_si128((const __m128i*) (run + x));
+		samples = _mm_or_si128(_mm_slli_epi16(samples, 8), _mm_srli_epi16(samples, 8)); // Swaps endianness
+		__m128 low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16)); // Sign extends to 32 bits
+		__m128 high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16));
+		_mm_storeu_ps(mix + x, _mm_add_ps(_mm_loadu_ps(mix + x), _mm_mul_ps(low, scale)));
+		_mm_storeu_ps(mix + x + 4, _mm_add_ps(_mm_loadu_ps(mix + x + 4), _mm_mul_ps(high, scale)));
+	}
+	for (; x < count; ++x)
+		mix[x] += (float) (int16_t) _byteswap_ushort(run[x]) * gain;
+}
+
+// Clamps the left and right mixes to 16 bits and interleaves them (Little Endian)
+static void interleaveMix(const float *left, const float *right, int16_t *output, unsigned int count) {
+	const __m128 lowest = _mm_set1_ps(-32768.0f);
+	const __m128 highest = _mm_set1_ps(32767.0f);
+	unsigned int x = 0;
+	for (; x + 8 <= count; x += 8) {
+		__m128i l0 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(left + x), lowest), highest));
+		__m128i l1 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(left + x + 4), lowest), highest));
+		__m128i r0 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(right + x), lowest), highest));
+		__m128i r1 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(right + x + 4), lowest), highest));
+		__m128i l = _mm_packs_epi32(l0, l1);
+		__m128i r = _mm_packs_epi32(r0, r1);
+		_mm_storeu_si128((__m128i*) (output + x * 2), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i*) (output + x * 2 + 8), _mm_unpackhi_epi16(l, r));
+	}
+	for (; x < count; ++x) {
+		float sides[2] = { left[x], right[x] };
+		for (int y = 0; y < 2; ++y) {
+			float value = sides[y];
+			if (value < -32768.0f)
+				value = -32768.0f;
+			else if (value > 32767.0f)
+				value = 32767.0f;
+			output[x * 2 + y] = (int16_t) lrintf(value); // Rounds half to even, same as _mm_cvtps_epi32
+		}
+	}
+}
+
+// Writes a 16-bit stereo PCM WAV header (Little Endian)
+static void printWAVHeader(FILE *outputWAV, unsigned int sampleRate, unsigned int numSamples) {
+	uint32_t dataSize = numSamples * 4;
+	uint32_t fourByteInt;
+	uint16_t twoByteShort;
+
+	fwrite("RIFF", 4, 1, outputWAV);
+	fourByteInt = dataSize + 36;
+	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputWAV);
+	fwrite("WAVEfmt ", 8, 1, outputWAV);
+	fourByteInt = 16; // Size of fmt chunk
+	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputWAV);
+	twoByteShort = 1; // PCM
+	fwrite(&twoByteShort, sizeof(twoByteShort), 1, outputWAV);
+	twoByteShort = 2; // Number of channels
+	fwrite(&twoByteShort, sizeof(twoByteShort), 1, outputWAV);
+	fwrite(&sampleRate, sizeof(sampleRate), 1, outputWAV);
+	fourByteInt = sampleRate * 4; // Bytes per second
+	fwrite(&fourByteInt, sizeof(fourByteInt), 1, outputWAV);
+	twoByteShort = 4; // Bytes per sample frame
+	fwrite(&twoByteShort, sizeof(twoByteShort), 1, outputWAV);
+	twoByteShort = 16; // Bits per sample
+	fwrite(&twoByteShort, sizeof(twoByteShort), 1, outputWAV);
+	fwrite("data", 4, 1, outputWAV);
+	fwrite(&dataSize, sizeof(dataSize), 1, outputWAV);
+}
+
+// Renders a stereo mix of the stems found in an AST file
+int renderAST(int argc, char **argv) {
+	string astFilename = argv[1];
+	string outputFilename = "";
+	string gainList = "";
+
+	// Parses through user arguments
+	for (int count = 2; count < argc; count++) {
+		if (strcmp(argv[count], "-h") == 0) {
+			printf(help.c_str());
+		}
+		else if (strcmp(argv[count], "-g") == 0 && count + 1 < argc) {
+			gainList = argv[++count];
+		}
+		else if (strcmp(argv[count], "-o") == 0 && count + 1 < argc) {
+			outputFilename = argv[++count];
+		}
+		else {
+			printf(help.c_str());
+			return 1;
+		}
+	}
+
+	// Defaults to the input filename with _mix.wav in place of .ast
+	if (outputFilename.empty())
+		outputFilename = astFilename.substr(0, astFilename.length() - 4) + "_mix.wav";
+	bool toStdout = outputFilename.compare("-") == 0;
+	FILE *status = toStdout ? stderr : stdout; // Keeps status messages out of audio streamed to stdout
+
+	FILE *sourceAST = fopen(astFilename.c_str(), "rb");
+	if (!sourceAST) {
+		fprintf(status, "ERROR: Cannot find/open input file!\n\n%s", help.c_str());
+		return 1;
+	}
+
+	// Reads AST header
+	unsigned char header[64];
+	if (fread(header, sizeof(header), 1, sourceAST) != 1 || memcmp(header, "STRM", 4) != 0) {
+		fprintf(status, "ERROR: Header contents of AST are invalid or corrupted.\n");
+		fclose(sourceAST);
+		return 1;
+	}
+	if (header[0x08] != 0 || header[0x09] != 1 || header[0x0A] != 0 || header[0x0B] != 16) {
+		fprintf(status, "ERROR: Only ASTs encoded with 16-bit PCM can be rendered!\n");
+		fclose(sourceAST);
+		return 1;
+	}
+	unsigned short numChannels = (header[0x0C] << 8) | header[0x0D];
+	unsigned int sampleRate = readBE32(header + 0x10);
+	unsigned int numSamples = readBE32(header + 0x14);
+	if (numChannels < 1 || numChannels > 16) {
+		fprintf(status, "ERROR: Invalid number of channels!\n");
+		fclose(sourceAST);
+		return 1;
+	}
+
+	// Parses stem gains (stems left out of the list are muted)
+	unsigned int numStems = (numChannels + 1) / 2;
+	vector<float> gains(numStems, gainList.empty() ? 1.0f : 0.0f);
+	if (!gainList.empty()) {
+		const char *c = gainList.c_str();
+		for (unsigned int stem = 0; *c != '\0'; ++stem) {
+			char *end;
+			double gain = strtod(c, &end);
+			if (end == c || (*end != ',' && *end != '\0')) {
+				fprintf(status, "ERROR: Stem gains \"%s\" are invalid!  Please enter a comma separated list of numbers.\n", gainList.c_str());
+				fclose(sourceAST);
+				return 1;
+			}
+			if (stem < numStems)
+				gains[stem] = (float) gain;
+			else if (stem == numStems)
+				fprintf(status, "WARNING: AST only contains %d stems.  Extra gains will be ignored.\n", numStems);
+			c = (*end == ',') ? end + 1 : end;
+		}
+	}
+
+	FILE *outputWAV;
+	if (toStdout) {
+		_setmode(_fileno(stdout), _O_BINARY);
+		outputWAV = stdout;
+	}
+	else {
+		outputWAV = fopen(outputFilename.c_str(), "wb");
+	}
+	if (!outputWAV) {
+		fprintf(status, "ERROR: Couldn't create file.\n");
+		fclose(sourceAST);
+		return 1;
+	}
+
+	fprintf(status, "File opened successfully!\n\n	Sample rate: %d Hz\n	Number of samples: %d\n	Number of stems: %d (gains:", sampleRate, numSamples, numStems);
+	for (unsigned int stem = 0; stem < numStems; ++stem)
+		fprintf(status, " %g", gains[stem]);
+	fprintf(status, ")\n\nRendering %s...", toStdout ? "to stdout" : outputFilename.c_str());
+
+	printWAVHeader(outputWAV, sampleRate, numSamples);
+
+	vector<uint16_t> run; // Stores one channel of the current block
+	vector<float> left, right; // Stores mix of the current block
+	vector<int16_t> printBlock; // Stores finalized stereo audio of the current block
+	uint64_t blockOffset = 64;
+	unsigned int remaining = numSamples;
+	int exit = 0;
+
+	while (remaining > 0) {
+		// Reads block header
+		unsigned char blockHeader[8];
+		_fseeki64(sourceAST, blockOffset, SEEK_SET);
+		if (fread(blockHeader, sizeof(blockHeader), 1, sourceAST) != 1 || memcmp(blockHeader, "BLCK", 4) != 0) {
+			fprintf(status, "\nERROR: AST ends early or a block is corrupted!\n");
+			exit = 1;
+			break;
+		}
+		unsigned int length = readBE32(blockHeader + 4); // Size of each channel in block
+		unsigned int count = length / 2;
+		if (count > remaining)
+			count = remaining; // Drops padding of the last block
+		if (count == 0) {
+			fprintf(status, "\nERROR: AST contains an empty block!\n");
+			exit = 1;
+			break;
+		}
+
+		run.resize(length / 2);
+		left.assign(count, 0.0f);
+		right.assign(count, 0.0f);
+		printBlock.resize(count * 2);
+
+		// Reads and mixes only the channels of audible stems
+		for (unsigned int channel = 0; channel < numChannels; ++channel) {
+			float gain = gains[channel / 2];
+			if (gain == 0.0f)
+				continue;
+			_fseeki64(sourceAST, blockOffset + 32 + (uint64_t) channel * length, SEEK_SET);
+			if (fread(&run[0], count * 2, 1, sourceAST) != 1) {
+				fprintf(status, "\nERROR: AST ends early or a block is corrupted!\n");
+				exit = 1;
+				break;
+			}
+			bool isMono = (channel % 2 == 0) && (channel + 1 == numChannels);
+			if (channel % 2 == 0 || isMono)
+				mixRun(&run[0], gain, &left[0], count);
+			if (channel % 2 == 1 || isMono)
+				mixRun(&run[0], gain, &right[0], count);
+		}
+		if (exit == 1)
+			break;
+
+		interleaveMix(&left[0], &right[0], &printBlock[0], count);
+		fwrite(&printBlock[0], count * 2 * sizeof(int16_t), 1, outputWAV);
+
+		remaining -= count;
+		blockOffset += 32 + (uint64_t) length * numChannels;
+	}
+
+	if (exit == 0)
+		fprintf(status, "...DONE!\n");
+	fclose(sourceAST);
+	if (!toStdout)
+		fclose(outputWAV);
+	else
+		fflush(stdout);
+	return exit;
+}
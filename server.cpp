@@ -0,0 +1,322 @@
+// server.cpp : serves virtual AST files over HTTP on localhost (-w) instead of writing them
+//
+// Every byte of an AST is a function of the source WAV and the layout worked out by validateAST, so any requested byte range
+// is built on the fly from only the header and the blocks it touches.  Recently built blocks are kept in a small cache.
+
+#include "stdafx.h"
+#include <winsock2.h>
+#include "main.h"
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+using namespace std;
+
+#define BLOCK_CACHE_SIZE 32 // Number of built blocks kept for later requests
+#define MAX_REQUEST_SIZE 8192 // Size limit of a request header
+#define CLIENT_TIMEOUT 5000 // Milliseconds a client may take to send its request header, or to accept more of a response
+
+// Stores a single AST being served
+struct VirtualAST {
+	string name; // Name of the AST in request paths
+	ASTInfo *info; // AST layout and settings
+	FILE *sourceWAV; // Source WAV file the AST is built from
+	uint64_t size; // Size of the whole AST file
+};
+
+// Stores a block that has already been built
+struct CachedBlock {
+	unsigned int file; // Index of the AST the block belongs to
+	unsigned int block; // Index of the block within its AST
+	uint64_t lastUse; // Request count at the time the block was last used
+	vector<unsigned char> data; // Block as it appears in the AST
+};
+
+// Reads a single block worth of audio straight from the source WAV file and converts it (returns its size in bytes, or 0 if the source could not be read)
+unsigned int ASTInfo::readBlock(FILE *sourceWAV, unsigned int x, uint16_t *block, unsigned char *output) {
+	uint32_t length = ((x == this->numBlocks - 1) ? this->excBlkSz : this->blockSize) * this->numChannels;
+	uint64_t sourceOffset = this->dataOffset + ((uint64_t) this->beginSample * 2 + (uint64_t) x * this->blockSize) * this->numChannels;
+	if (_fseeki64(sourceWAV, sourceOffset, SEEK_SET) != 0 || fread(&block[0], length, 1, sourceWAV) != 1)
+		return 0;
+	return buildBlock(x, block, output);
+}
+
+// Sends a whole buffer (returns false if the connection was lost or stalled past the timeout)
+static bool sendAll(SOCKET client, const void *data, uint64_t size) {
+	const char *position = (const char*) data;
+	while (size > 0) {
+		int chunk = size > 65536 ? 65536 : (int) size;
+		int sent = send(client, position, chunk, 0);
+		if (sent <= 0)
+			return false;
+		position += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+// Sends a response without a body (or with a short text body)
+static void sendStatus(SOCKET client, const char *status, const char *extraHeaders, const string &body, bool isHead) {
+	char headers[512];
+	sprintf(headers, "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n%sConnection: close\r\n\r\n", status, (int) body.length(), extraHeaders);
+	sendAll(client, headers, strlen(headers));
+	if (!isHead)
+		sendAll(client, body.c_str(), body.length());
+}
+
+// Parses the value of a Range header against the size of a file (returns 1 if a range was found, 0 if the whole file should be sent, -1 if the range can not be satisfied)
+static int parseRange(const char *value, uint64_t size, uint64_t *start, uint64_t *end) {
+	while (*value == ' ')
+		value++;
+	if (_strnicmp(value, "bytes=", 6) != 0 || strchr(value, ',') != NULL) // Multiple ranges are answered with the whole file
+		return 0;
+	value += 6;
+
+	char *next;
+	if (*value == '-') { // Last n bytes
+		uint64_t suffix = strtoull(value + 1, &next, 10);
+		if (next == value + 1 || suffix == 0)
+			return -1;
+		*start = suffix >= size ? 0 : size - suffix;
+		*end = size - 1;
+		return 1;
+	}
+
+	uint64_t first = strtoull(value, &next, 10);
+	if (next == value || *next != '-')
+		return 0;
+	value = next + 1;
+	uint64_t last = strtoull(value, &next, 10);
+	if (next == value) // Open ended range
+		last = size - 1;
+	if (first >= size)
+		return -1;
+	if (last < first)
+		return 0;
+	*start = first;
+	*end = last < size ? last : size - 1;
+	return 1;
+}
+
+// Decodes %XX escapes of a request path
+static string decodePath(const string &path) {
+	string decoded;
+	for (unsigned int x = 0; x < path.length(); ++x) {
+		if (path[x] == '%' && x + 2 < path.length() && isxdigit((unsigned char) path[x + 1]) && isxdigit((unsigned char) path[x + 2])) {
+			decoded += (char) strtol(path.substr(x + 1, 2).c_str(), NULL, 16);
+			x += 2;
+		}
+		else {
+			decoded += path[x];
+		}
+	}
+	return decoded;
+}
+
+// Finds a block in the cache, building it (and evicting the least recently used block) if it is missing
+static const vector<unsigned char> *getBlock(vector<VirtualAST> &files, vector<CachedBlock> &cache, vector<uint16_t> &block, unsigned int file, unsigned int x, uint64_t requestCount) {
+	CachedBlock *slot = NULL;
+	for (unsigned int y = 0; y < cache.size(); ++y) {
+		if (cache[y].file == file && cache[y].block == x) {
+			cache[y].lastUse = requestCount;
+			return &cache[y].data;
+		}
+		if (!slot || cache[y].lastUse < slot->lastUse)
+			slot = &cache[y];
+	}
+	if (cache.size() < BLOCK_CACHE_SIZE) {
+		cache.push_back(CachedBlock());
+		slot = &cache.back();
+	}
+
+	ASTInfo *info = files[file].info;
+	slot->data.resize((size_t) (info->blockOffset(1) - info->blockOffset(0)));
+	unsigned int size = info->readBlock(files[file].sourceWAV, x, &block[0], &slot->data[0]);
+	slot->file = file;
+	slot->block = x;
+	slot->lastUse = requestCount;
+	if (size == 0) {
+		slot->block = (unsigned int) -1; // Keeps the failed slot from being found again
+		return NULL;
+	}
+	slot->data.resize(size);
+	return &slot->data;
+}
+
+// Answers a single HTTP request
+static void handleRequest(SOCKET client, vector<VirtualAST> &files, vector<CachedBlock> &cache, vector<uint16_t> &block, uint64_t requestCount) {
+	// Reads request header (a client trickling it in can not hold up other clients past the deadline)
+	string request;
+	char buffer[1024];
+	ULONGLONG deadline = GetTickCount64() + CLIENT_TIMEOUT;
+	while (request.find("\r\n\r\n") == string::npos && request.length() < MAX_REQUEST_SIZE) {
+		if (GetTickCount64() >= deadline)
+			return;
+		int received = recv(client, buffer, sizeof(buffer), 0);
+		if (received <= 0) // Connection was closed, lost or stalled past the timeout
+			return;
+		request.append(buffer, received);
+	}
+
+	// Splits request line into method and path
+	size_t lineEnd = request.find("\r\n");
+	string line = request.substr(0, lineEnd);
+	size_t space = line.find(' ');
+	size_t space2 = line.find(' ', space + 1);
+	if (lineEnd == string::npos || space == string::npos || space2 == string::npos) {
+		sendStatus(client, "400 Bad Request", "", "Bad request\n", false);
+		return;
+	}
+	string method = line.substr(0, space);
+	string path = line.substr(space + 1, space2 - space - 1);
+	bool isHead = method.compare("HEAD") == 0;
+	if (!isHead && method.compare("GET") != 0) {
+		sendStatus(client, "405 Method Not Allowed", "Allow: GET, HEAD\r\n", "Only GET and HEAD are supported\n", false);
+		return;
+	}
+	path = decodePath(path.substr(0, path.find('?')));
+	path = path.substr(path.find_last_of('/') + 1);
+
+	// Lists every AST being served
+	if (path.empty()) {
+		string list;
+		for (unsigned int x = 0; x < files.size(); ++x)
+			list += files[x].name + "\n";
+		sendStatus(client, "200 OK", "", list, isHead);
+		return;
+	}
+
+	unsigned int file = 0;
+	while (file < files.size() && _stricmp(files[file].name.c_str(), path.c_str()) != 0)
+		file++;
+	if (file == files.size()) {
+		sendStatus(client, "404 Not Found", "", "No such AST\n", isHead);
+		return;
+	}
+	ASTInfo *info = files[file].info;
+	uint64_t size = files[file].size;
+
+	// Looks for a Range header
+	uint64_t start = 0, end = size - 1;
+	int isRange = 0;
+	for (size_t position = lineEnd + 2; position < request.length();) {
+		size_t next = request.find("\r\n", position);
+		if (next == string::npos || next == position)
+			break;
+		if (_strnicmp(request.c_str() + position, "Range:", 6) == 0)
+			isRange = parseRange(request.substr(position + 6, next - position - 6).c_str(), size, &start, &end);
+		position = next + 2;
+	}
+
+	char headers[512];
+	if (isRange == -1) {
+		sprintf(headers, "Content-Range: bytes */%llu\r\n", (unsigned long long) size);
+		sendStatus(client, "416 Range Not Satisfiable", headers, "", isHead);
+		return;
+	}
+	if (isRange == 1)
+		sprintf(headers, "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %llu-%llu/%llu\r\n", (unsigned long long) start, (unsigned long long) end, (unsigned long long) size);
+	else
+		sprintf(headers, "HTTP/1.1 200 OK\r\n");
+	sprintf(headers + strlen(headers), "Content-Type: application/octet-stream\r\nContent-Length: %llu\r\nAccept-Ranges: bytes\r\nConnection: close\r\n\r\n", (unsigned long long) (end - start + 1));
+	if (!sendAll(client, headers, strlen(headers)) || isHead)
+		return;
+
+	// Sends whatever part of the header was requested
+	uint64_t position = start;
+	if (position < 64) {
+		unsigned char header[64];
+		info->buildHeader(header);
+		uint64_t headerEnd = end < 63 ? end + 1 : 64;
+		if (!sendAll(client, &header[position], headerEnd - position))
+			return;
+		position = headerEnd;
+	}
+
+	// Builds and sends only the blocks that overlap the requested range
+	while (position <= end) {
+		unsigned int x = info->blockAt(position);
+		const vector<unsigned char> *data = getBlock(files, cache, block, file, x, requestCount);
+		if (!data) {
+			printf("ERROR: Couldn't read block %d of %s from its source file!\n", x, files[file].name.c_str());
+			return;
+		}
+		uint64_t blockStart = info->blockOffset(x);
+		uint64_t blockEnd = blockStart + data->size();
+		if (blockEnd > end + 1)
+			blockEnd = end + 1;
+		if (!sendAll(client, &(*data)[(size_t) (position - blockStart)], blockEnd - position))
+			return;
+		position = blockEnd;
+	}
+}
+
+// Serves virtual AST files over HTTP on localhost until the program is closed
+int runRangeServer(vector<ASTInfo> &infos) {
+	unsigned short port = infos[0].webPort;
+
+	// Opens every source WAV file
+	vector<VirtualAST> files;
+	size_t maxBlock = 0;
+	for (unsigned int x = 0; x < infos.size(); ++x) {
+		VirtualAST file;
+		file.info = &infos[x];
+		file.name = infos[x].filename.substr(infos[x].filename.find_last_of("/\\") + 1);
+		file.size = (uint64_t) infos[x].astSize + 64;
+		file.sourceWAV = fopen(infos[x].sourceFilename.c_str(), "rb");
+		if (!file.sourceWAV) {
+			printf("ERROR: Cannot find/open input file %s!\n", infos[x].sourceFilename.c_str());
+			for (unsigned int y = 0; y < files.size(); ++y)
+				fclose(files[y].sourceWAV);
+			return 1;
+		}
+		if ((size_t) infos[x].blockSize * infos[x].numChannels > maxBlock)
+			maxBlock = (size_t) infos[x].blockSize * infos[x].numChannels;
+		files.push_back(file);
+	}
+	vector<uint16_t> block(maxBlock / 2); // Used to read and store audio data from a source file
+	vector<CachedBlock> cache;
+
+	// Listens on localhost only
+	WSADATA wsaData;
+	SOCKET listener = INVALID_SOCKET;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) == 0)
+		listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (listener == INVALID_SOCKET || bind(listener, (sockaddr*) &address, sizeof(address)) == SOCKET_ERROR || listen(listener, SOMAXCONN) == SOCKET_ERROR) {
+		printf("ERROR: Couldn't listen on port %d!  It may already be in use.\n", port);
+		if (listener != INVALID_SOCKET)
+			closesocket(listener);
+		for (unsigned int x = 0; x < files.size(); ++x)
+			fclose(files[x].sourceWAV);
+		WSACleanup();
+		return 1;
+	}
+
+	printf("Serving %d virtual AST files on http://localhost:%d/ (press Ctrl+C to stop)...\n\n", (int) files.size(), port);
+	for (unsigned int x = 0; x < files.size(); ++x)
+		printf("	/%s (%llu bytes, built from %s)\n", files[x].name.c_str(), (unsigned long long) files[x].size, files[x].info->sourceFilename.c_str());
+	printf("\n");
+	fflush(stdout);
+
+	// Answers one request per connection
+	for (uint64_t requestCount = 0; ; ++requestCount) {
+		SOCKET client = accept(listener, NULL, NULL);
+		if (client == INVALID_SOCKET)
+			continue;
+		// Drops clients that stall, since they would otherwise keep every other client waiting
+		DWORD timeout = CLIENT_TIMEOUT;
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*) &timeout, sizeof(timeout));
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*) &timeout, sizeof(timeout));
+		handleRequest(client, files, cache, block, requestCount);
+		closesocket(client);
+	}
+}
@@ -0,0 +1,223 @@
+// encoder_stress.cpp : multiplexes many streaming encoders (encoder.h) on one thread and checks each AST against the one ASTCreate.exe writes
+//
+// Builds without the rest of the program (from the project directory):
+//	cl /EHsc /I. tests\encoder_stress.cpp encoder.cpp astinfo.cpp
+//
+// Usage:
+//	encoder_stress.exe [path to ASTCreate.exe] [number of encoders (default: 400)]
+//
+// Source audio is generated from a fixed seed and written to stress_*.wav in the current directory, ASTCreate.exe converts every
+// WAV to stress_*.ast (both are removed again once the AST has been read), and the encoders then build the same ASTs with pushes
+// and consumes of random sizes, round robin on this thread.  Every pulled span is checked against the AST at its offset as it
+// arrives, so the test itself holds no output.  Memory stays bounded if no push reaches past the block being filled and no pull
+// returns more than one block.
+// Returns 0 if every encoder produced exactly the AST written by ASTCreate.exe within those bounds.
+
+#include "stdafx.h"
+#include "encoder.h"
+#include <string>
+#include <vector>
+#include <process.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+// Stores settings of a single test AST
+struct StressSource {
+	unsigned short numChannels;
+	unsigned int sampleRate;
+	unsigned int numSamples;
+	unsigned int loopStart;
+	bool isLooped;
+	vector<int16_t> audio; // Interleaved source audio
+	string reference; // AST written by ASTCreate.exe
+	unsigned int blockFrames; // Number of frames in a full block (from the header of the reference)
+	unsigned int maxPull; // Largest span a pull may return (header or a whole block)
+};
+
+// Stores a single encoder along with its progress
+struct StressEncoder {
+	unsigned int source; // Index of the source being encoded
+	ASTEncoder encoder;
+	unsigned int framesPushed = 0; // Number of frames accepted so far
+	uint64_t outputSize = 0; // Number of bytes pulled and checked so far
+	const char *failure = NULL; // Describes the first problem found (NULL while the encoder is fine)
+};
+
+static uint32_t randomState = 12345; // Fixed seed, so every run pushes and consumes the same way
+
+// Returns a pseudo-random number (LCG, the same on every compiler)
+static uint32_t nextRandom() {
+	randomState = randomState * 1103515245 + 12345;
+	return (randomState >> 8) & 0xFFFFFF;
+}
+
+// Writes interleaved audio to a 16-bit PCM WAV file
+static bool writeWAV(const char *filename, const StressSource &source) {
+	FILE *wav = fopen(filename, "wb");
+	if (!wav)
+		return false;
+	uint32_t dataSize = (uint32_t) source.audio.size() * 2;
+	uint32_t riffSize = 36 + dataSize;
+	uint32_t fmtSize = 16;
+	uint16_t format = 1;
+	uint32_t byteRate = source.sampleRate * 2 * source.numChannels;
+	uint16_t blockAlign = 2 * source.numChannels;
+	uint16_t bitsPerSample = 16;
+	fwrite("RIFF", 4, 1, wav);
+	fwrite(&riffSize, 4, 1, wav);
+	fwrite("WAVEfmt ", 8, 1, wav);
+	fwrite(&fmtSize, 4, 1, wav);
+	fwrite(&format, 2, 1, wav);
+	fwrite(&source.numChannels, 2, 1, wav);
+	fwrite(&source.sampleRate, 4, 1, wav);
+	fwrite(&byteRate, 4, 1, wav);
+	fwrite(&blockAlign, 2, 1, wav);
+	fwrite(&bitsPerSample, 2, 1, wav);
+	fwrite("data", 4, 1, wav);
+	fwrite(&dataSize, 4, 1, wav);
+	fwrite(&source.audio[0], dataSize, 1, wav);
+	return fclose(wav) == 0;
+}
+
+// Reads a whole file into a string (returns false if it can not be read)
+static bool readFile(const char *filename, string &data) {
+	FILE *file = fopen(filename, "rb");
+	if (!file)
+		return false;
+	char buffer[65536];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.append(buffer, length);
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printf("Usage: %s [path to ASTCreate.exe] [number of encoders (default: 400)]\n", argv[0]);
+		return 1;
+	}
+	unsigned int numEncoders = argc > 2 ? atoi(argv[2]) : 400;
+
+	// Covers mono to many channels, a single block, an exact multiple of the block size and unlooped audio
+	StressSource sources[] = {
+		{ 2, 32000, 100000, 5000, true },
+		{ 1, 48000, 7001, 0, false },
+		{ 4, 32000, 30000, 100, true },
+		{ 6, 22050, 5040 * 3, 2520, true },
+		{ 16, 44100, 1234, 1, true },
+	};
+	unsigned int numSources = sizeof(sources) / sizeof(sources[0]);
+
+	// Writes every source and has ASTCreate.exe convert it
+	string quotedExe = "\"" + string(argv[1]) + "\""; // Keeps a path with spaces in one argument
+	for (unsigned int x = 0; x < numSources; ++x) {
+		StressSource &source = sources[x];
+		source.audio.resize((size_t) source.numSamples * source.numChannels);
+		for (size_t y = 0; y < source.audio.size(); ++y)
+			source.audio[y] = (int16_t) nextRandom();
+
+		char wavName[32], astName[32], loopStart[16];
+		sprintf(wavName, "stress_%u.wav", x);
+		sprintf(astName, "stress_%u.ast", x);
+		sprintf(loopStart, "%u", source.loopStart);
+		if (!writeWAV(wavName, source)) {
+			printf("ERROR: Couldn't write %s!\n", wavName);
+			return 1;
+		}
+		remove(astName);
+		if (source.isLooped)
+			_spawnl(_P_WAIT, argv[1], quotedExe.c_str(), wavName, "-o", astName, "-s", loopStart, NULL);
+		else
+			_spawnl(_P_WAIT, argv[1], quotedExe.c_str(), wavName, "-o", astName, "-n", NULL);
+		bool isRead = readFile(astName, source.reference);
+		remove(wavName);
+		remove(astName);
+		if (!isRead || source.reference.size() < 64) {
+			printf("ERROR: %s didn't write %s!\n", argv[1], astName);
+			return 1;
+		}
+
+		// Size of the first block is stored Big Endian at 0x0020 of the header (bytes per channel)
+		const unsigned char *header = (const unsigned char*) source.reference.data();
+		uint32_t blockSize = ((uint32_t) header[0x20] << 24) | ((uint32_t) header[0x21] << 16) | ((uint32_t) header[0x22] << 8) | header[0x23];
+		source.blockFrames = blockSize / 2;
+		source.maxPull = 32 + blockSize * source.numChannels > 64 ? 32 + blockSize * source.numChannels : 64;
+	}
+
+	// Starts every encoder
+	vector<StressEncoder> encoders(numEncoders);
+	for (unsigned int x = 0; x < numEncoders; ++x) {
+		StressSource &source = sources[x % numSources];
+		encoders[x].source = x % numSources;
+		if (encoders[x].encoder.begin(source.numChannels, source.sampleRate, source.numSamples, source.loopStart, source.isLooped) == 1) {
+			printf("ERROR: Encoder %u couldn't start!\n%s", x, encoders[x].encoder.getErrors().c_str());
+			return 1;
+		}
+	}
+
+	// Gives every encoder a little work at a time until all of them are done
+	unsigned int numDone = 0;
+	uint64_t numRounds = 0;
+	while (numDone < numEncoders) {
+		numDone = 0;
+		numRounds++;
+		for (unsigned int x = 0; x < numEncoders; ++x) {
+			StressEncoder &stress = encoders[x];
+			StressSource &source = sources[stress.source];
+			if (stress.failure || stress.encoder.isDone()) {
+				numDone++;
+				continue;
+			}
+
+			// Pushes a random number of frames, which must stay within the block being filled
+			unsigned int numFrames = nextRandom() % 3000;
+			if (numFrames > source.numSamples - stress.framesPushed)
+				numFrames = source.numSamples - stress.framesPushed;
+			unsigned int accepted = stress.encoder.push(source.audio.data() + (size_t) stress.framesPushed * source.numChannels, numFrames);
+			if (accepted > numFrames) {
+				stress.failure = "push accepted more frames than it was given";
+				continue;
+			}
+			if (accepted > 0 && stress.framesPushed / source.blockFrames != (stress.framesPushed + accepted - 1) / source.blockFrames) {
+				stress.failure = "push reached past the block being filled";
+				continue;
+			}
+			stress.framesPushed += accepted;
+
+			// Takes part of the output, like a socket that isn't always ready, and checks it against the reference right away
+			unsigned int size;
+			const unsigned char *bytes = stress.encoder.pull(&size);
+			if (size == 0)
+				continue;
+			if (size > source.maxPull) {
+				stress.failure = "pull returned more than one block";
+				continue;
+			}
+			unsigned int sent = 1 + nextRandom() % size;
+			if (stress.outputSize + sent > source.reference.size() || memcmp(bytes, source.reference.data() + stress.outputSize, sent) != 0) {
+				stress.failure = "output doesn't match ASTCreate.exe";
+				continue;
+			}
+			stress.outputSize += sent;
+			stress.encoder.consume(sent);
+		}
+	}
+
+	// Checks that every AST was complete
+	unsigned int numMismatches = 0;
+	for (unsigned int x = 0; x < numEncoders; ++x) {
+		StressEncoder &stress = encoders[x];
+		if (!stress.failure && (stress.outputSize != sources[stress.source].reference.size() || stress.outputSize != stress.encoder.totalSize()))
+			stress.failure = "AST is shorter than the one written by ASTCreate.exe";
+		if (stress.failure) {
+			if (numMismatches < 10)
+				printf("Encoder %u (source %u) failed after %llu bytes: %s\n", x, stress.source, (unsigned long long) stress.outputSize, stress.failure);
+			numMismatches++;
+		}
+	}
+	printf("%u encoders on %u sources finished in %llu rounds, %u mismatches\n", numEncoders, numSources, (unsigned long long) numRounds, numMismatches);
+	return numMismatches == 0 ? 0 : 1;
+}
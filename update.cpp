@@ -0,0 +1,136 @@
+// update.cpp : incremental re-encode (-i) rewriting only the blocks whose source audio changed
+//
+// Each block of an AST is built from a fixed range of source frames once the block size and channel count are known.
+// A sidecar file next to the AST ([output file].blkhash) keeps a hash of the source audio behind every block, so a later
+// build only has to rewrite the blocks whose hash changed (along with the header, which is always rewritten).
+//
+// Sidecar layout (byte order of the machine that wrote it):
+//	0x0000  "ASTH"
+//	0x0004  version (1)
+//	0x0008  block size, number of channels, number of samples, number of blocks (4 bytes each)
+//	0x0018  64-bit FNV-1a hash of the source audio of each block
+
+#include "stdafx.h"
+#include "main.h"
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <windows.h>
+
+using namespace std;
+
+#define BLOCK_HASH_VERSION 1
+
+// Hashes a block worth of source audio (64-bit FNV-1a)
+static uint64_t hashBlock(const unsigned char *data, uint32_t size) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (uint32_t x = 0; x < size; ++x) {
+		hash ^= data[x];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Reads the block hashes of the previous build (returns false if they are missing or were made with a different layout)
+bool ASTInfo::readBlockHashes(const string &hashFilename, vector<uint64_t> &hashes) {
+	FILE *hashFile = fopen(hashFilename.c_str(), "rb");
+	if (!hashFile)
+		return false;
+
+	char magic[4];
+	uint32_t fields[5]; // Version, block size, number of channels, number of samples, number of blocks
+	bool isValid = fread(magic, sizeof(magic), 1, hashFile) == 1 && memcmp(magic, "ASTH", 4) == 0
+		&& fread(fields, sizeof(fields), 1, hashFile) == 1 && fields[0] == BLOCK_HASH_VERSION
+		&& fields[1] == this->blockSize && fields[2] == this->numChannels && fields[3] == this->numSamples && fields[4] == this->numBlocks;
+	if (isValid) {
+		hashes.resize(this->numBlocks);
+		isValid = fread(&hashes[0], sizeof(uint64_t), this->numBlocks, hashFile) == this->numBlocks;
+	}
+	fclose(hashFile);
+	return isValid;
+}
+
+// Removes the block hashes of an AST about to be written in full without -i (they would describe audio the AST no longer holds)
+void ASTInfo::removeBlockHashes() {
+	remove((this->filename + ".blkhash").c_str());
+}
+
+// Updates an existing AST in place, rewriting only the blocks whose source audio changed (writes the whole AST if it can not be updated)
+int ASTInfo::updateAST(FILE *sourceWAV) {
+	string hashFilename = this->filename + ".blkhash";
+
+	// Reuses the existing AST only if it has the exact layout of the new one
+	vector<uint64_t> oldHashes;
+	FILE *outputAST = NULL;
+	if (readBlockHashes(hashFilename, oldHashes)) {
+		outputAST = fopen(this->filename.c_str(), "r+b");
+		if (outputAST && (_fseeki64(outputAST, 0, SEEK_END) != 0 || _ftelli64(outputAST) != (int64_t) this->astSize + 64)) {
+			fclose(outputAST);
+			outputAST = NULL;
+		}
+	}
+	bool isFullBuild = !outputAST;
+	if (isFullBuild)
+		outputAST = fopen(this->filename.c_str(), "wb");
+	if (!outputAST) {
+		printf("ERROR: Couldn't create file.\n");
+		return 1;
+	}
+
+	// Removes the old hashes until the update is finished, so that an interrupted update is never mistaken for a finished one
+	remove(hashFilename.c_str());
+
+	printInfo(); // Prints AST information to user
+
+	printf("\n\n%s %s...", isFullBuild ? "Writing" : "Updating", this->filename.c_str());
+
+	_fseeki64(outputAST, 0, SEEK_SET);
+	printHeader(outputAST); // Writes header info to output (loop points and sample rate may have changed)
+
+	unsigned char *block = (unsigned char*) malloc(this->blockSize * this->numChannels); // Used to read and store audio data from the original file
+	unsigned char *printBlock = (unsigned char*) malloc(32 + this->blockSize * this->numChannels); // Stores all finalized block data being printed to AST file
+	vector<uint64_t> hashes(this->numBlocks);
+	unsigned int numWritten = 0;
+	int exit = 0;
+
+	for (unsigned int x = 0; x < this->numBlocks; ++x) {
+		uint32_t length = ((x == this->numBlocks - 1) ? this->excBlkSz : this->blockSize) * this->numChannels;
+		if (fread(block, length, 1, sourceWAV) != 1) {
+			printf("\nERROR: Source WAV ends before the end of its audio data!\n");
+			exit = 1;
+			break;
+		}
+		hashes[x] = hashBlock(block, length);
+		if (!isFullBuild && hashes[x] == oldHashes[x])
+			continue;
+
+		unsigned int size = buildBlock(x, (const uint16_t*) block, printBlock);
+		_fseeki64(outputAST, blockOffset(x), SEEK_SET);
+		fwrite(printBlock, size, 1, outputAST); // Writes processed block over its old version
+		numWritten++;
+	}
+	free(block);
+	free(printBlock);
+	if (fclose(outputAST) != 0 && exit == 0) {
+		printf("\nERROR: Couldn't finish writing %s!\n", this->filename.c_str());
+		exit = 1;
+	}
+	if (exit == 1)
+		return 1;
+
+	// Stores the new hashes for the next update
+	FILE *hashFile = fopen(hashFilename.c_str(), "wb");
+	uint32_t fields[5] = { BLOCK_HASH_VERSION, this->blockSize, this->numChannels, this->numSamples, this->numBlocks };
+	if (!hashFile || fwrite("ASTH", 4, 1, hashFile) != 1 || fwrite(fields, sizeof(fields), 1, hashFile) != 1
+	  || fwrite(&hashes[0], sizeof(uint64_t), this->numBlocks, hashFile) != this->numBlocks) {
+		printf("...DONE!\nWARNING: Couldn't write block hashes to %s.  The next update will rewrite the whole AST.\n", hashFilename.c_str());
+		if (hashFile)
+			fclose(hashFile);
+		remove(hashFilename.c_str());
+		return 0;
+	}
+	fclose(hashFile);
+
+	printf("...DONE!  Rewrote %u of %u blocks.\n", numWritten, this->numBlocks);
+	return 0;
+}